@@ -0,0 +1,584 @@
+// Micro-benchmarks for the engine's hot data paths. Every result is printed as one JSON object
+// per line so runs from different commits can be diffed or fed to a script.
+
+#include "kai/graph.h"
+#include "kai/interest.h"
+#include "kai/net.h"
+#include "kai/query.h"
+#include "kai/scripting.h"
+#include "kai/storage.h"
+#include <boost/program_options.hpp>
+#include <filesystem>
+
+namespace po = boost::program_options;
+using Clock = std::chrono::steady_clock;
+
+// Keeps the compiler from discarding a value whose computation is being measured.
+template<typename T>
+inline void keep(T&& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+template<typename F>
+int64_t timed(uint64_t iterations, F&& f) {
+    auto start = Clock::now();
+    for(uint64_t i = 0; i < iterations; i++) f(i);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+struct Benchmark {
+    std::string name;
+    // Runs the benchmark body the given number of times and returns the nanoseconds spent in it,
+    // so that any per-batch setup is left out of the measurement.
+    std::function<int64_t(uint64_t)> body;
+};
+
+static std::vector<Benchmark> benchmarks;
+
+static void add(std::string name, std::function<int64_t(uint64_t)> body) {
+    benchmarks.push_back(Benchmark{std::move(name), std::move(body)});
+}
+
+static const std::string clientDataFrame = R"({"kind":"client_data","id":42,"data":[{"cmd":"text","args":["say Hello there, how is everyone doing today?"],"kwargs":{}}]})";
+static const std::string clientReadyFrame = R"({"kind":"client_ready","protocol":{"id":42,"capabilities":{"protocol":"Telnet","client_name":"Mudlet","client_version":"4.17.2","host_address":"203.0.113.7","host_port":51234,"host_names":["example.net"],"encoding":"utf-8","utf8":true,"width":120,"height":40,"gmcp":true,"msdp":false,"mssp":true,"mxp":true,"mccp2":true,"ttype":true,"naws":true,"sga":true}}})";
+
+static void linkBenchmarks() {
+    add("link.json.parse.client_data", [](uint64_t n) {
+        return timed(n, [](auto) { keep(nlohmann::json::parse(clientDataFrame)); });
+    });
+    add("link.json.parse.client_ready", [](uint64_t n) {
+        return timed(n, [](auto) { keep(nlohmann::json::parse(clientReadyFrame)); });
+    });
+    add("link.json.dump.client_data", [](uint64_t n) {
+        // Shaped like the frames Connection::sendMessage() hands to the Link writer.
+        nlohmann::json j, d;
+        j["kind"] = "client_data";
+        j["id"] = 42;
+        d["cmd"] = "text";
+        d["args"].push_back("You say, 'Hello there, how is everyone doing today?'\r\n");
+        d["kwargs"] = nlohmann::json::object();
+        j["data"].push_back(d);
+        return timed(n, [&](auto) { keep(j.dump(-1, ' ', false, nlohmann::json::error_handler_t::ignore)); });
+    });
+    add("net.capabilities.deserialize", [](uint64_t n) {
+        auto caps = nlohmann::json::parse(clientReadyFrame)["protocol"]["capabilities"];
+        return timed(n, [&](auto) {
+            net::ProtocolCapabilities c;
+            c.deserialize(caps);
+            keep(c);
+        });
+    });
+    add("net.message.construct", [](uint64_t n) {
+        auto frame = nlohmann::json::parse(clientDataFrame);
+        auto& data = frame["data"][0];
+        return timed(n, [&](auto) { keep(net::Message(data)); });
+    });
+}
+
+static void attributeBenchmarks() {
+    static std::vector<std::string> categories, names;
+    for(int i = 0; i < 8; i++) categories.push_back(fmt::format("category{}", i));
+    for(int i = 0; i < 16; i++) names.push_back(fmt::format("attribute{}", i));
+
+    auto filled = [] {
+        AttributeManager<double> a;
+        for(auto& c : categories) for(auto& n : names) a.set(c, n, 1.0);
+        return a;
+    };
+
+    add("attributes.get.hit", [=](uint64_t n) {
+        auto a = filled();
+        return timed(n, [&](auto i) { keep(a.get(categories[i % 8], names[i % 16])); });
+    });
+    add("attributes.get.miss", [=](uint64_t n) {
+        auto a = filled();
+        std::string missing = "missing";
+        return timed(n, [&](auto i) { keep(a.get(categories[i % 8], missing)); });
+    });
+    add("attributes.set.existing", [=](uint64_t n) {
+        auto a = filled();
+        return timed(n, [&](auto i) { a.set(categories[i % 8], names[i % 16], static_cast<double>(i)); });
+    });
+    add("attributes.has", [=](uint64_t n) {
+        auto a = filled();
+        return timed(n, [&](auto i) { keep(a.has(categories[i % 8], names[i % 16])); });
+    });
+    add("attributes.find.symbol", [=](uint64_t n) {
+        auto a = filled();
+        std::vector<symbols::Symbol> c, m;
+        for(auto& s : categories) c.push_back(symbols::intern(s));
+        for(auto& s : names) m.push_back(symbols::intern(s));
+        return timed(n, [&](auto i) { keep(a.find(c[i % 8], m[i % 16])); });
+    });
+    add("attributes.iterate.category", [=](uint64_t n) {
+        auto a = filled();
+        auto category = symbols::intern(categories[3]);
+        return timed(n, [&](auto) {
+            double total = 0;
+            for(auto& e : a.entries(category)) total += e.value;
+            keep(total);
+        });
+    });
+}
+
+static void scriptBenchmarks() {
+    static script::ScriptManager manager;
+
+    add("script.compile.hit", [](uint64_t n) {
+        std::string source = "local x = 0\nfor i = 1, 10 do x = x + i end\nreturn x";
+        manager.compile(source);
+        return timed(n, [&](auto) { keep(manager.compile(source)); });
+    });
+    add("script.compile.miss", [](uint64_t n) {
+        static uint64_t unique = 0;
+        std::vector<std::string> sources;
+        sources.reserve(n);
+        for(uint64_t i = 0; i < n; i++) sources.push_back(fmt::format("local x = {}\nfor i = 1, 10 do x = x + i end\nreturn x", unique++));
+        return timed(n, [&](auto i) { keep(manager.compile(sources[i])); });
+    });
+    add("script.task.spawn_run", [](uint64_t n) {
+        auto code = manager.compile("local x = 0\nfor i = 1, 10 do x = x + i end\nreturn x");
+        return timed(n, [&](auto) {
+            auto thread = manager.createThread();
+            script::Task task(thread, code);
+            task.load();
+            task.run();
+            manager.releaseThread(thread);
+        });
+    });
+}
+
+static void objectBenchmarks() {
+    add("gameobject.create", [](uint64_t n) {
+        GameModule module("bench");
+        return timed(n, [&](auto) { keep(module.createGameObject()); });
+    });
+    add("gameobject.relation.set", [](uint64_t n) {
+        GameModule module("bench");
+        std::vector<std::shared_ptr<GameObject>> objects;
+        for(int i = 0; i < 1024; i++) objects.push_back(module.createGameObject().lock());
+        return timed(n, [&](auto i) {
+            objects[i % 1024]->setRelation("exit", objects[(i * 7 + 1) % 1024]);
+        });
+    });
+    add("gameobject.relation.get", [](uint64_t n) {
+        GameModule module("bench");
+        std::vector<std::shared_ptr<GameObject>> objects;
+        for(int i = 0; i < 1024; i++) objects.push_back(module.createGameObject().lock());
+        for(int i = 0; i < 1024; i++) objects[i]->setRelation("exit", objects[(i + 1) % 1024]);
+        return timed(n, [&](auto i) { keep(objects[i % 1024]->getRelation("exit")); });
+    });
+    add("gameobject.relation.get.symbol", [](uint64_t n) {
+        GameModule module("bench");
+        std::vector<std::shared_ptr<GameObject>> objects;
+        for(int i = 0; i < 1024; i++) objects.push_back(module.createGameObject().lock());
+        auto exit = symbols::intern("exit");
+        for(int i = 0; i < 1024; i++) objects[i]->setRelation(exit, objects[(i + 1) % 1024]);
+        return timed(n, [&](auto i) { keep(objects[i % 1024]->getRelation(exit)); });
+    });
+    add("gameobject.parent.set", [](uint64_t n) {
+        GameModule module("bench");
+        std::vector<std::shared_ptr<GameObject>> objects;
+        for(int i = 0; i < 1024; i++) objects.push_back(module.createGameObject().lock());
+        // items moving between 64 rooms.
+        return timed(n, [&](auto i) { objects[64 + i % 960]->setParent(objects[(i * 13 + 5) % 64]); });
+    });
+    add("gameobject.contents.iterate", [](uint64_t n) {
+        GameModule module("bench");
+        std::vector<std::shared_ptr<GameObject>> objects;
+        for(int i = 0; i < 1024; i++) objects.push_back(module.createGameObject().lock());
+        for(int i = 64; i < 1024; i++) objects[i]->setParent(objects[i % 64]);
+        return timed(n, [&](auto i) {
+            size_t count = 0;
+            for(auto& obj : objects[i % 64]->descendants()) count += obj.getID() != 0;
+            keep(count);
+        });
+    });
+    add("gameobject.lookup.id", [](uint64_t n) {
+        GameModule module("bench");
+        std::vector<std::pair<int64_t, int64_t>> ids;
+        for(int i = 0; i < 65536; i++) {
+            auto obj = module.createGameObject().lock();
+            ids.emplace_back(obj->getID(), obj->getGeneration());
+        }
+        return timed(n, [&](auto i) {
+            auto& [id, generation] = ids[(i * 40503) & 65535];
+            keep(module.getGameObject(id, generation).lock());
+        });
+    });
+    add("gameobject.lookup.handle", [](uint64_t n) {
+        GameModule module("bench");
+        std::vector<ObjectHandle> handles;
+        for(int i = 0; i < 65536; i++) handles.push_back(module.createGameObject().lock()->getHandle());
+        return timed(n, [&](auto i) { keep(module.resolve(handles[(i * 40503) & 65535])); });
+    });
+    add("query.find.index", [](uint64_t n) {
+        GameModule module("bench");
+        for(int i = 0; i < 65536; i++) module.createGameObject().lock()->setStat("proto", "vnum", i % 4096);
+        query::Attribute vnum(ObjectField::Stats, "proto", "vnum");
+        module.createIndex(vnum, query::IndexKind::Hash);
+        return timed(n, [&](auto i) { keep(query::find(module, vnum, double(i % 4096))); });
+    });
+    add("query.find.scan", [](uint64_t n) {
+        GameModule module("bench");
+        for(int i = 0; i < 65536; i++) module.createGameObject().lock()->setStat("proto", "vnum", i % 4096);
+        query::Attribute vnum(ObjectField::Stats, "proto", "vnum");
+        return timed(n, [&](auto i) { keep(query::find(module, vnum, double(i % 4096))); });
+    });
+
+    // Pathing over a synthetic 100k-room world: a 316x316 grid of gridRooms joined by n/s/e/w exits,
+    // each room carrying its coordinates as stats for the A* heuristic.
+    static std::shared_ptr<GameModule> grid;
+    static std::vector<std::shared_ptr<GameObject>> gridRooms;
+    static std::unique_ptr<graph::Graph> exits;
+    constexpr int side = 316;
+    static const std::string coords = "coords";
+    auto buildGrid = [] {
+        if(grid) return;
+        grid = std::make_shared<GameModule>("bench_grid");
+        gameModules["bench_grid"] = grid;
+        for(int i = 0; i < side * side; i++) {
+            auto room = grid->createGameObject().lock();
+            room->setStat(coords, "x", i % side);
+            room->setStat(coords, "y", i / side);
+            gridRooms.push_back(room);
+        }
+        auto north = symbols::intern("north"), south = symbols::intern("south");
+        auto east = symbols::intern("east"), west = symbols::intern("west");
+        for(int y = 0; y < side; y++) {
+            for(int x = 0; x < side; x++) {
+                auto& room = gridRooms[y * side + x];
+                if(y > 0) room->setRelation(north, gridRooms[(y - 1) * side + x]);
+                if(y < side - 1) room->setRelation(south, gridRooms[(y + 1) * side + x]);
+                if(x < side - 1) room->setRelation(east, gridRooms[y * side + x + 1]);
+                if(x > 0) room->setRelation(west, gridRooms[y * side + x - 1]);
+            }
+        }
+        grid->takeDirty();
+        exits = std::make_unique<graph::Graph>(std::vector<std::string>{"north", "south", "east", "west"},
+                                               std::vector<std::string>{"bench_grid"});
+    };
+    // pairs about 30 gridRooms apart, the distance a track or a mob hunt usually spans.
+    auto pair = [](uint64_t i) {
+        auto from = static_cast<int>((i * 40503) % (side * side));
+        auto x = std::min(side - 1, from % side + 15), y = std::min(side - 1, from / side + 15);
+        return std::make_pair(gridRooms[from].get(), gridRooms[y * side + x].get());
+    };
+    add("graph.build.100k", [=](uint64_t n) {
+        buildGrid();
+        return timed(n, [&](auto) { exits->rebuild(); });
+    });
+    add("graph.bfs.100k", [=](uint64_t n) {
+        buildGrid();
+        graph::SearchOptions options;
+        options.useCache = false;
+        return timed(n, [&](auto i) {
+            auto [from, to] = pair(i);
+            keep(exits->findPath(*from, *to, options));
+        });
+    });
+    add("graph.astar.100k", [=](uint64_t n) {
+        buildGrid();
+        auto x = symbols::intern("x"), y = symbols::intern("y"), category = symbols::intern(coords);
+        graph::SearchOptions options;
+        options.useCache = false;
+        options.heuristic = [=](const GameObject& a, const GameObject& b) {
+            auto at = [&](const GameObject& o, symbols::Symbol axis) {
+                auto v = o.findStat(category, axis);
+                return v ? *v : 0.0;
+            };
+            return static_cast<uint32_t>(std::abs(at(a, x) - at(b, x)) + std::abs(at(a, y) - at(b, y)));
+        };
+        return timed(n, [&](auto i) {
+            auto [from, to] = pair(i);
+            keep(exits->findPath(*from, *to, options));
+        });
+    });
+    add("graph.path.cached.100k", [=](uint64_t n) {
+        buildGrid();
+        // 256 hunters chasing their targets; the cache is warm after the first lap.
+        return timed(n, [&](auto i) {
+            auto [from, to] = pair(i % 256);
+            keep(exits->findPath(*from, *to));
+        });
+    });
+    add("graph.relation.patch.100k", [=](uint64_t n) {
+        buildGrid();
+        // a door closing and opening again: one lost and one regained edge per op.
+        auto east = symbols::intern("east");
+        return timed(n, [&](auto i) {
+            auto& room = gridRooms[(i * 40503) % (side * (side - 1))];
+            auto target = room->getRelation(east);
+            room->setRelation(east, nullptr);
+            room->setRelation(east, target);
+        });
+    });
+
+    // Room-scoped delivery with 10k players spread over 1000 rooms in 10 areas. One op finds the
+    // recipients of one room message.
+    static std::shared_ptr<GameModule> town;
+    static std::vector<std::shared_ptr<GameObject>> townRooms, players;
+    static std::vector<std::unique_ptr<PlayView>> views;
+    auto populateTown = [] {
+        if(town) return;
+        town = std::make_shared<GameModule>("bench_town");
+        std::vector<std::shared_ptr<GameObject>> areas;
+        for(int i = 0; i < 10; i++) areas.push_back(town->createGameObject().lock());
+        for(int i = 0; i < 1000; i++) {
+            townRooms.push_back(town->createGameObject().lock());
+            townRooms.back()->setParent(areas[i % 10]);
+        }
+        for(int i = 0; i < 10000; i++) {
+            players.push_back(town->createGameObject().lock());
+            players.back()->setParent(townRooms[(i * 7919) % 1000]);
+            views.push_back(std::make_unique<PlayView>(players.back()));
+        }
+        town->takeDirty();
+    };
+    add("interest.room.recipients", [=](uint64_t n) {
+        populateTown();
+        return timed(n, [&](auto i) { keep(interest::inside(*townRooms[i % 1000])); });
+    });
+    add("interest.room.scan", [=](uint64_t n) {
+        // The baseline: looking at every player to find who is in the room.
+        populateTown();
+        return timed(n, [&](auto i) {
+            std::vector<GameObject*> found;
+            auto room = townRooms[i % 1000].get();
+            for(auto& p : players) {
+                if(p->parentLink().resolve() == room) found.push_back(p.get());
+            }
+            keep(found);
+        });
+    });
+    add("interest.move", [=](uint64_t n) {
+        // walking to a room of the same area, as most moves do.
+        populateTown();
+        return timed(n, [&](auto i) {
+            auto& player = players[i % 10000];
+            auto index = player->parentLink().resolve()->getID() - townRooms[0]->getID();
+            player->setParent(townRooms[(index + 10) % 1000]);
+        });
+    });
+
+    // World-wide sweeps over 500k objects, as a regen system would run them. One op is one full
+    // sweep.
+    struct Vitals {
+        double hp, maxHp, regen;
+    };
+    static std::shared_ptr<GameModule> world;
+    static const std::string vitals = "vitals", hp = "hp";
+    auto populate = [] {
+        if(world) return;
+        world = std::make_shared<GameModule>("bench_world");
+        for(int i = 0; i < 500000; i++) {
+            auto obj = world->createGameObject().lock();
+            obj->addComponent<Vitals>(10.0, 100.0, 0.5);
+            obj->setStat(vitals, hp, 10.0);
+        }
+        world->takeDirty();
+    };
+    add("components.sweep.500k", [=](uint64_t n) {
+        populate();
+        auto view = world->view<Vitals>();
+        return timed(n, [&](auto) {
+            view.each([](Vitals& v) { v.hp = std::min(v.maxHp, v.hp + v.regen); });
+        });
+    });
+    add("gameobject.sweep.500k", [=](uint64_t n) {
+        // Only reads, through the object façade: the baseline the component store replaces.
+        populate();
+        return timed(n, [&](auto) {
+            double total = 0.0;
+            for(auto& [id, obj] : world->getGameObjects()) total += obj->getStat(vitals, hp);
+            keep(total);
+        });
+    });
+
+    // A room-like object: a parent, a few exits and a handful of attributes.
+    static auto module = std::make_shared<GameModule>("bench_serial");
+    gameModules["bench_serial"] = module;
+    static std::vector<std::shared_ptr<GameObject>> rooms;
+    for(int i = 0; i < 16; i++) rooms.push_back(module->createGameObject().lock());
+    auto room = rooms[0];
+    room->setParent(rooms[1]);
+    size_t next = 2;
+    for(auto exit : {"north", "east", "south", "west", "up", "down"}) room->setRelation(exit, rooms[next++]);
+    for(auto stat : {"strength", "agility", "speed", "constitution"}) room->setStat("stats", stat, 10.0);
+    room->setString("text", "name", "A dusty crossroads");
+    room->setString("text", "description", "Four roads meet here under a sky the colour of old iron.");
+
+    add("gameobject.serialize.json", [=](uint64_t n) {
+        return timed(n, [&](auto) { keep(room->serialize().dump()); });
+    });
+    add("gameobject.serialize.binary", [=](uint64_t n) {
+        return timed(n, [&](auto) { keep(room->serializeBinary()); });
+    });
+    add("gameobject.deserialize.json", [=](uint64_t n) {
+        auto text = room->serialize().dump();
+        return timed(n, [&](auto) { rooms[15]->deserialize(nlohmann::json::parse(text)); });
+    });
+    add("gameobject.deserialize.binary", [=](uint64_t n) {
+        auto blob = room->serializeBinary();
+        return timed(n, [&](auto) { rooms[15]->deserializeBinary(blob); });
+    });
+}
+
+static void commandBenchmarks() {
+    static commands::CommandRegistry registry;
+    static commands::AliasTable aliases;
+    for(auto name : {"north", "east", "south", "west", "up", "down", "look", "get", "give", "say", "score", "shout"}) {
+        registry.add(name, nullptr);
+    }
+    for(int i = 0; i < 500; i++) registry.add(fmt::format("command{}", i), nullptr);
+    for(int i = 0; i < 50; i++) aliases.set(fmt::format("alias{}", i), "say hello;look");
+
+    add("commands.resolve.abbreviation", [](uint64_t n) {
+        std::string input = "gi sword bob";
+        return timed(n, [&](auto) { keep(registry.resolve(input, 0, &aliases)); });
+    });
+    add("commands.resolve.exact", [](uint64_t n) {
+        std::string input = "command250 with some arguments";
+        return timed(n, [&](auto) { keep(registry.resolve(input, 0, &aliases)); });
+    });
+    add("commands.resolve.alias", [](uint64_t n) {
+        std::string input = "alias25 orc";
+        return timed(n, [&](auto) { keep(registry.resolve(input, 0, &aliases)); });
+    });
+}
+
+static std::vector<storage::ObjectRecord> objectRecords(uint64_t n) {
+    static uint64_t nextId = 0;
+    // roughly the size of a serialized room with a handful of relations.
+    std::string data(256, 'x');
+    std::vector<storage::ObjectRecord> records(n);
+    for(auto& r : records) {
+        r.module = "bench";
+        r.id = static_cast<int64_t>(nextId++ % 100000);
+        r.generation = 1;
+        r.data = data;
+    }
+    return records;
+}
+
+static void storageBenchmarks() {
+    // Each op is one object saved, so ops_per_second reads as objects saved per second.
+    static auto path = (std::filesystem::temp_directory_path() / fmt::format("kai-bench-{}.sqlite3", getpid())).string();
+    static std::unique_ptr<storage::Store> store;
+
+    auto open = [] {
+        if(store) return;
+        store = std::make_unique<storage::Store>(path);
+        store->createSchema();
+    };
+
+    add("storage.save.bulk", [=](uint64_t n) {
+        open();
+        auto records = objectRecords(n);
+        return timed(1, [&](auto) { store->saveObjects(records); });
+    });
+    add("storage.save.naive", [=](uint64_t n) {
+        // What a save path looks like without the storage layer: SQL text prepared per batch,
+        // one row per statement.
+        open();
+        auto records = objectRecords(n);
+        return timed(1, [&](auto) {
+            SQLite::Transaction transaction(store->db());
+            SQLite::Statement st(store->db(), "INSERT INTO objects (module, id, generation, data) VALUES (?, ?, ?, ?) "
+                                              "ON CONFLICT(module, id) DO UPDATE SET generation=excluded.generation, data=excluded.data");
+            for(auto& r : records) {
+                st.bind(1, r.module);
+                st.bind(2, r.id);
+                st.bind(3, r.generation);
+                st.bind(4, r.data.data(), static_cast<int>(r.data.size()));
+                st.exec();
+                st.reset();
+            }
+            transaction.commit();
+        });
+    });
+    std::atexit([] {
+        store.reset();
+        for(auto suffix : {"", "-wal", "-shm"}) std::filesystem::remove(path + suffix);
+    });
+}
+
+int main(int argc, char **argv)
+{
+    std::string filter, label;
+    int repeats;
+    double minBatchMs;
+
+    po::options_description desc("Usage: bench [options]");
+    desc.add_options()
+            ("help,h", "Print this help.")
+            ("filter", po::value<std::string>(&filter), "Only run benchmarks whose name contains this text.")
+            ("repeats", po::value<int>(&repeats)->default_value(7), "Measured batches per benchmark.")
+            ("min-batch-ms", po::value<double>(&minBatchMs)->default_value(50.0), "Minimum duration of one batch.")
+            ("label", po::value<std::string>(&label), "Copied into every result, e.g. a commit hash.")
+            ("list", "List the benchmarks and exit.");
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch(const std::exception& e) {
+        std::cerr << e.what() << std::endl << desc << std::endl;
+        return 1;
+    }
+    if(vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    // Task::run() logs its status; keep that out of the numbers.
+    logger = std::make_shared<spdlog::logger>("bench");
+    logger->set_level(spdlog::level::off);
+
+    linkBenchmarks();
+    attributeBenchmarks();
+    scriptBenchmarks();
+    objectBenchmarks();
+    commandBenchmarks();
+    storageBenchmarks();
+
+    if(vm.count("list")) {
+        for(auto& b : benchmarks) std::cout << b.name << std::endl;
+        return 0;
+    }
+
+    repeats = std::max(repeats, 1);
+    auto minBatch = static_cast<int64_t>(minBatchMs * 1e6);
+    for(auto& b : benchmarks) {
+        if(!filter.empty() && b.name.find(filter) == std::string::npos) continue;
+
+        nlohmann::json j;
+        j["name"] = b.name;
+        if(!label.empty()) j["label"] = label;
+
+        // Find a batch size that runs long enough for the clock to be irrelevant.
+        uint64_t iterations = 1;
+        std::vector<double> perOp;
+        try {
+            while(b.body(iterations) < minBatch && iterations < (uint64_t(1) << 30)) iterations *= 2;
+            for(int r = 0; r < repeats; r++) {
+                perOp.push_back(static_cast<double>(b.body(iterations)) / iterations);
+            }
+        } catch(const std::exception& e) {
+            // one broken benchmark should not cost the rest of the run.
+            j["error"] = e.what();
+            std::cout << j.dump() << std::endl;
+            continue;
+        }
+        std::sort(perOp.begin(), perOp.end());
+
+        j["iterations"] = iterations;
+        j["repeats"] = repeats;
+        j["ns_per_op"] = perOp[perOp.size() / 2];
+        j["ns_per_op_min"] = perOp.front();
+        j["ns_per_op_max"] = perOp.back();
+        j["ops_per_second"] = perOp[perOp.size() / 2] > 0 ? 1e9 / perOp[perOp.size() / 2] : 0.0;
+        std::cout << j.dump() << std::endl;
+    }
+    return 0;
+}
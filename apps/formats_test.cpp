@@ -0,0 +1,140 @@
+// Checks the on-disk formats: the binary object encoding and the journal's frames. Run through
+// ctest; exits non-zero if any check fails.
+
+#include "kai/db.h"
+#include "kai/journal.h"
+#include "kai/serialization.h"
+#include "kai/storage.h"
+#include <fstream>
+
+namespace {
+    int failures = 0;
+
+    void check(bool ok, std::string_view what) {
+        if(ok) return;
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+
+    // Nested fields, with lengths of one, two and three varint bytes at every level.
+    void testFields() {
+        serial::Writer w;
+        std::string big(20000, 'b'), medium(200, 'm');
+        auto outer = w.beginField(1);
+        w.key("exits");
+        auto inner = w.beginField(2);
+        w.str(medium);
+        auto innermost = w.beginField(3);
+        w.str(big);
+        w.endField(innermost);
+        w.svarint(-42);
+        w.endField(inner);
+        w.f64(2.5);
+        w.endField(outer);
+        auto empty = w.beginField(4);
+        w.endField(empty);
+        auto blob = w.finish(serial::Kind::GameObject, 7);
+
+        serial::Reader r(blob, serial::Kind::GameObject);
+        check(r.version() == 7, "format version");
+        uint32_t tag;
+        serial::Reader field, nested, deepest;
+        check(r.nextField(tag, field) && tag == 1, "outer field");
+        check(field.key() == "exits", "interned key");
+        check(field.nextField(tag, nested) && tag == 2, "nested field");
+        check(nested.str() == medium, "nested string");
+        check(nested.nextField(tag, deepest) && tag == 3, "innermost field");
+        check(deepest.str() == big && deepest.atEnd(), "innermost string");
+        check(nested.svarint() == -42 && nested.atEnd(), "value after a nested field");
+        check(field.f64() == 2.5 && field.atEnd(), "value after two nested fields");
+        check(r.nextField(tag, field) && tag == 4 && field.atEnd(), "empty field");
+        check(!r.nextField(tag, field), "end of body");
+    }
+
+    void testObject() {
+        auto module = std::make_shared<GameModule>("formats");
+        gameModules["formats"] = module;
+        auto room = module->createGameObject().lock(), other = module->createGameObject().lock();
+        auto obj = module->createGameObject().lock();
+        obj->setParent(room);
+        obj->setRelation("north", other);
+        obj->setStat("stats", "strength", 18.5);
+        obj->setString("text", "name", std::string(300, 'n'));
+        auto blob = obj->serializeBinary();
+
+        auto copy = module->createGameObject().lock();
+        copy->deserializeBinary(blob);
+        check(copy->getParent() && copy->getParent()->getID() == room->getID(), "object parent");
+        check(copy->getRelation("north") && copy->getRelation("north")->getID() == other->getID(), "object relation");
+        check(copy->getStat("stats", "strength") == 18.5, "object stat");
+        check(copy->getString("text", "name") == std::string(300, 'n'), "object string");
+        gameModules.erase("formats");
+    }
+
+    storage::ObjectRecord record(int64_t id) {
+        storage::ObjectRecord r;
+        r.module = "formats";
+        r.id = id;
+        r.generation = 1;
+        r.data = std::string(64, static_cast<char>('a' + id));
+        return r;
+    }
+
+    // Writes three one-record frames, damages the last one and replays what is left.
+    std::set<int64_t> replayDamaged(const std::filesystem::path& dir, const std::function<void(const std::filesystem::path&)>& damage) {
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        auto base = (dir / "journal").string();
+        journal::open(base);
+        for(int64_t id = 1; id <= 3; id++) {
+            std::vector<storage::ObjectRecord> batch{record(id)};
+            journal::append(static_cast<uint64_t>(id), journal::encode(batch));
+        }
+        journal::close();
+
+        damage(dir / "journal.000001");
+
+        storage::Store store((dir / "db.sqlite3").string());
+        store.createSchema();
+        journal::replay(base, store);
+        std::set<int64_t> found;
+        for(int64_t id = 1; id <= 3; id++) {
+            if(store.objectGeneration("formats", id)) found.insert(id);
+        }
+        return found;
+    }
+
+    void testJournal() {
+        auto dir = std::filesystem::temp_directory_path() / "kai_formats_test";
+        auto intact = replayDamaged(dir, [](auto&) {});
+        check(intact == std::set<int64_t>{1, 2, 3}, "journal replays every frame");
+        check(!std::filesystem::exists(dir / "journal.000001"), "replayed segments are deleted");
+
+        auto flipped = replayDamaged(dir, [](const std::filesystem::path& segment) {
+            auto last = static_cast<std::streamoff>(std::filesystem::file_size(segment) - 1);
+            std::fstream f(segment, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekg(last);
+            char c = static_cast<char>(f.get() ^ 0xFF);
+            f.seekp(last);
+            f.put(c);
+        });
+        check(flipped == std::set<int64_t>{1, 2}, "journal replay stops at a bad CRC");
+
+        auto torn = replayDamaged(dir, [](const std::filesystem::path& segment) {
+            std::filesystem::resize_file(segment, std::filesystem::file_size(segment) - 1);
+        });
+        check(torn == std::set<int64_t>{1, 2}, "journal replay stops at a torn frame");
+
+        std::filesystem::remove_all(dir);
+    }
+}
+
+int main(int argc, char **argv) {
+    logger = spdlog::default_logger();
+    testFields();
+    testObject();
+    testJournal();
+    if(failures) std::cerr << failures << " checks failed." << std::endl;
+    else std::cout << "All format checks passed." << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,293 @@
+// A stand-in for Thermite that speaks its Link protocol to a running kai, simulating a crowd of
+// scripted clients. It reports command-to-output latency percentiles and Link frame rates.
+
+#include "kai/net.h"
+#include "kai/profiler.h"
+#include <boost/program_options.hpp>
+#include <charconv>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+
+namespace po = boost::program_options;
+using namespace std::chrono_literals;
+using boost::asio::awaitable;
+using boost::asio::use_awaitable;
+using tcp = boost::asio::ip::tcp;
+using WebSocket = boost::beast::websocket::stream<boost::beast::tcp_stream>;
+
+struct Options {
+    uint16_t port{7000};
+    int clients{1000};
+    int rampPerSecond{200};
+    std::chrono::seconds duration{60s};
+    std::chrono::milliseconds thinkMin{1000ms}, thinkMax{5000ms};
+    std::vector<std::pair<std::string, int>> mix;
+    int totalWeight{0};
+};
+
+struct Client {
+    int64_t id;
+    // when the oldest command that has not been answered yet was sent; 0 when idle.
+    int64_t pendingSince{0};
+    bool connected{false};
+};
+
+struct Stats {
+    profiler::Histogram latency;
+    uint64_t framesIn{0}, framesOut{0}, commands{0}, answered{0};
+    uint64_t lastFramesIn{0}, lastFramesOut{0};
+};
+
+static Options options;
+static Stats stats;
+static std::vector<Client> clients;
+static std::unique_ptr<net::Channel<std::string>> outbox;
+static bool finished = false;
+
+// Reports what is wrong with the mix on std::cerr and returns nothing when it is unusable.
+static std::optional<std::vector<std::pair<std::string, int>>> parseMix(const std::string& text) {
+    // "look=5,say hello=2,score=1"
+    std::vector<std::pair<std::string, int>> out;
+    std::vector<std::string> parts;
+    boost::split(parts, text, boost::is_any_of(","));
+    int64_t total = 0;
+    for(auto& p : parts) {
+        if(p.empty()) continue;
+        auto eq = p.rfind('=');
+        int weight = 1;
+        if(eq != std::string::npos) {
+            auto digits = std::string_view(p).substr(eq + 1);
+            auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), weight);
+            if(ec != std::errc() || end != digits.data() + digits.size()) {
+                std::cerr << "The command " << p.substr(0, eq) << " has no valid weight: '" << digits << "'." << std::endl;
+                return std::nullopt;
+            }
+        }
+        auto cmd = eq == std::string::npos ? p : p.substr(0, eq);
+        if(weight < 0) {
+            std::cerr << "The command " << cmd << " has a negative weight." << std::endl;
+            return std::nullopt;
+        }
+        total += weight;
+        if(total > std::numeric_limits<int>::max()) {
+            std::cerr << "The weights of the command mix add up to more than " << std::numeric_limits<int>::max() << "." << std::endl;
+            return std::nullopt;
+        }
+        out.emplace_back(std::move(cmd), weight);
+    }
+    return out;
+}
+
+static const std::string& pickCommand(std::mt19937& rng) {
+    auto roll = std::uniform_int_distribution<int>(0, options.totalWeight - 1)(rng);
+    for(auto& [cmd, weight] : options.mix) {
+        if(roll < weight) return cmd;
+        roll -= weight;
+    }
+    return options.mix.back().first;
+}
+
+static void send(const nlohmann::json& j) {
+    if(outbox->try_send(boost::system::error_code{}, j.dump())) stats.framesOut++;
+}
+
+static nlohmann::json clientProtocol(int64_t id) {
+    nlohmann::json p;
+    p["id"] = id;
+    p["capabilities"]["protocol"] = "Telnet";
+    p["capabilities"]["client_name"] = "loadgen";
+    p["capabilities"]["client_version"] = "1.0";
+    p["capabilities"]["host_address"] = "127.0.0.1";
+    p["capabilities"]["utf8"] = true;
+    return p;
+}
+
+static awaitable<void> runClient(Client& c, std::chrono::milliseconds startDelay) {
+    boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor);
+    std::mt19937 rng(c.id);
+    std::uniform_int_distribution<int64_t> think(options.thinkMin.count(), options.thinkMax.count());
+
+    timer.expires_after(startDelay);
+    co_await timer.async_wait(use_awaitable);
+    if(finished) co_return;
+
+    nlohmann::json ready;
+    ready["kind"] = "client_ready";
+    ready["protocol"] = clientProtocol(c.id);
+    send(ready);
+    c.connected = true;
+
+    while(!finished) {
+        timer.expires_after(std::chrono::milliseconds(think(rng)));
+        co_await timer.async_wait(use_awaitable);
+        if(finished || !c.connected) break;
+
+        nlohmann::json j;
+        j["kind"] = "client_data";
+        j["id"] = c.id;
+        j["data"].push_back({{"cmd", "text"}, {"args", {pickCommand(rng)}}, {"kwargs", nlohmann::json::object()}});
+        if(!c.pendingSince) c.pendingSince = profiler::now();
+        stats.commands++;
+        send(j);
+    }
+    co_return;
+}
+
+static awaitable<void> runReader(WebSocket& ws) {
+    boost::beast::flat_buffer buffer;
+    while(!finished) {
+        buffer.clear();
+        co_await ws.async_read(buffer, use_awaitable);
+        stats.framesIn++;
+        auto j = nlohmann::json::parse(boost::beast::buffers_to_string(buffer.data()), nullptr, false);
+        if(j.is_discarded() || !j.contains("id")) continue;
+        auto id = j["id"].get<int64_t>();
+        if(id < 1 || id > static_cast<int64_t>(clients.size())) continue;
+        auto& c = clients[id - 1];
+
+        std::string kind = j.value("kind", "");
+        if(kind == "client_data" && c.pendingSince) {
+            stats.latency.record(profiler::now() - c.pendingSince);
+            stats.answered++;
+            c.pendingSince = 0;
+        } else if(kind == "client_disconnected") {
+            c.connected = false;
+        }
+    }
+}
+
+static awaitable<void> runWriter(WebSocket& ws) {
+    while(true) {
+        auto text = co_await outbox->async_receive(use_awaitable);
+        co_await ws.async_write(boost::asio::buffer(text), use_awaitable);
+    }
+}
+
+static awaitable<void> runReporter() {
+    boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor);
+    auto start = std::chrono::steady_clock::now();
+    while(!finished) {
+        timer.expires_after(1s);
+        co_await timer.async_wait(use_awaitable);
+        auto online = std::count_if(clients.begin(), clients.end(), [](auto& c) { return c.connected; });
+        fmt::print("[{:>4}s] clients {:>6}  frames/s to kai {:>7}  from kai {:>7}  p50 {:.2f}ms  p99 {:.2f}ms\n",
+                   std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count(),
+                   online, stats.framesOut - stats.lastFramesOut, stats.framesIn - stats.lastFramesIn,
+                   stats.latency.percentile(50.0) / 1e6, stats.latency.percentile(99.0) / 1e6);
+        stats.lastFramesOut = stats.framesOut;
+        stats.lastFramesIn = stats.framesIn;
+        if(std::chrono::steady_clock::now() - start >= options.duration) finished = true;
+    }
+}
+
+static awaitable<void> runSession(tcp::socket socket) {
+    using namespace boost::asio::experimental::awaitable_operators;
+    WebSocket ws(std::move(socket));
+    co_await ws.async_accept(use_awaitable);
+    fmt::print("kai connected. Ramping up {} clients at {}/s.\n", options.clients, options.rampPerSecond);
+
+    // A fresh Link always opens with the list of clients Thermite already knows about.
+    nlohmann::json list;
+    list["kind"] = "client_list";
+    list["data"] = nlohmann::json::array();
+    send(list);
+
+    auto executor = co_await boost::asio::this_coro::executor;
+    clients.clear();
+    for(int i = 0; i < options.clients; i++) clients.push_back(Client{i + 1});
+    for(int i = 0; i < options.clients; i++) {
+        auto delay = std::chrono::milliseconds(i * 1000 / std::max(options.rampPerSecond, 1));
+        boost::asio::co_spawn(executor, runClient(clients[i], delay), boost::asio::detached);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        co_await (runReader(ws) || runWriter(ws) || runReporter());
+    } catch(const std::exception& e) {
+        fmt::print("Link closed: {}\n", e.what());
+    }
+    finished = true;
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for(auto& c : clients) {
+        if(!c.connected) continue;
+        nlohmann::json j;
+        j["kind"] = "client_disconnected";
+        j["id"] = c.id;
+        try {
+            co_await ws.async_write(boost::asio::buffer(j.dump()), use_awaitable);
+        } catch(...) {
+            break;
+        }
+    }
+
+    nlohmann::json summary;
+    summary["clients"] = options.clients;
+    summary["seconds"] = seconds;
+    summary["commands"] = stats.commands;
+    summary["answered"] = stats.answered;
+    summary["frames_to_kai_per_second"] = stats.framesOut / seconds;
+    summary["frames_from_kai_per_second"] = stats.framesIn / seconds;
+    summary["latency_ms"]["p50"] = stats.latency.percentile(50.0) / 1e6;
+    summary["latency_ms"]["p90"] = stats.latency.percentile(90.0) / 1e6;
+    summary["latency_ms"]["p99"] = stats.latency.percentile(99.0) / 1e6;
+    summary["latency_ms"]["max"] = stats.latency.max() / 1e6;
+    std::cout << summary.dump() << std::endl;
+    co_return;
+}
+
+int main(int argc, char **argv)
+{
+    std::string mix;
+    int duration, thinkMin, thinkMax;
+
+    po::options_description desc("Usage: loadgen [options]");
+    desc.add_options()
+            ("help,h", "Print this help.")
+            ("port,p", po::value<uint16_t>(&options.port)->default_value(7000), "Port kai's Link connects to.")
+            ("clients,n", po::value<int>(&options.clients)->default_value(1000), "Number of simulated clients.")
+            ("ramp", po::value<int>(&options.rampPerSecond)->default_value(200), "Clients connected per second.")
+            ("duration", po::value<int>(&duration)->default_value(60), "Seconds to run once kai connects.")
+            ("think-min", po::value<int>(&thinkMin)->default_value(1000), "Minimum think time between commands, in ms.")
+            ("think-max", po::value<int>(&thinkMax)->default_value(5000), "Maximum think time between commands, in ms.")
+            ("mix", po::value<std::string>(&mix)->default_value("look=5,say hello=2,score=1,inventory=1"),
+             "Weighted command mix, as command=weight pairs separated by commas.");
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch(const std::exception& e) {
+        std::cerr << e.what() << std::endl << desc << std::endl;
+        return 1;
+    }
+    if(vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    options.duration = std::chrono::seconds(duration);
+    options.thinkMin = std::chrono::milliseconds(thinkMin);
+    options.thinkMax = std::chrono::milliseconds(std::max(thinkMin, thinkMax));
+    auto parsed = parseMix(mix);
+    if(!parsed) return 1;
+    options.mix = std::move(*parsed);
+    for(auto& [cmd, weight] : options.mix) options.totalWeight += weight;
+    if(options.mix.empty() || options.totalWeight <= 0) {
+        std::cerr << "The command mix must contain at least one command with a positive weight." << std::endl;
+        return 1;
+    }
+
+    boost::asio::io_context io;
+    outbox = std::make_unique<net::Channel<std::string>>(io, options.clients * 4 + 16);
+
+    boost::asio::co_spawn(io, [&]() -> awaitable<void> {
+        tcp::acceptor acceptor(io, tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), options.port));
+        fmt::print("Waiting for kai on port {}...\n", options.port);
+        auto socket = co_await acceptor.async_accept(use_awaitable);
+        co_await runSession(std::move(socket));
+        io.stop();
+    }, boost::asio::detached);
+
+    io.run();
+    return 0;
+}
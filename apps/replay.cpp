@@ -0,0 +1,86 @@
+// Replays a Link recording made with config::linkRecordFile against the game loop, without a
+// Thermite, and reports tick-time and throughput statistics.
+
+#include "kai/comm.h"
+#include "kai/config.h"
+#include "kai/profiler.h"
+#include "kai/replay.h"
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+int main(int argc, char **argv)
+{
+    std::string file, dir;
+    bool fast = false;
+    int heartbeat = 0;
+
+    po::options_description desc("Usage: replay [options] <recording>");
+    desc.add_options()
+            ("help,h", "Print this help.")
+            ("recording", po::value<std::string>(&file), "The Link recording to play back.")
+            ("fast,f", po::bool_switch(&fast), "Feed frames as fast as possible instead of in real time.")
+            ("heartbeat", po::value<int>(&heartbeat), "Override the heartbeat interval, in milliseconds.")
+            ("dir,d", po::value<std::string>(&dir)->default_value("lib"), "Library directory.");
+    po::positional_options_description pos;
+    pos.add("recording", 1);
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(pos).run(), vm);
+        po::notify(vm);
+    } catch(const std::exception& e) {
+        std::cerr << e.what() << std::endl << desc << std::endl;
+        return 1;
+    }
+    if(vm.count("help") || file.empty()) {
+        std::cout << desc << std::endl;
+        return vm.count("help") ? 0 : 1;
+    }
+    file = std::filesystem::absolute(file).string();
+
+    try {
+        setup_log();
+    }
+    catch(std::exception& e) {
+        std::cerr << "Cannot start logger: " << e.what() << std::endl;
+        exit(1);
+    }
+    std::filesystem::current_path(dir);
+
+    // Keep every tick of the run in the percentiles, not just the last minute.
+    config::profilerWindow = std::chrono::hours(24 * 365);
+    if(vm.count("heartbeat")) config::heartbeatInterval = std::chrono::milliseconds(heartbeat);
+
+    gameFunc = [&]() -> boost::asio::awaitable<void> {
+        auto game = co_await boost::asio::this_coro::executor;
+        boost::asio::co_spawn(boost::asio::make_strand(*net::io), [&, game]() -> boost::asio::awaitable<void> {
+            auto stats = co_await net::replayLink(file, !fast);
+            // The profiler belongs to the game strand. The loop is waiting out its last tick
+            // by now, so this runs before it shuts down.
+            auto snap = co_await boost::asio::co_spawn(game, []() -> boost::asio::awaitable<nlohmann::json> {
+                co_return profiler::snapshot();
+            }, boost::asio::use_awaitable);
+            logger->info("Replay results:");
+            logger->info("  frames in:  {} ({} bytes, {:.1f} frames/s)", stats.framesIn, stats.bytesIn,
+                         stats.seconds > 0 ? stats.framesIn / stats.seconds : 0.0);
+            logger->info("  frames out: {} ({} bytes, {:.1f} frames/s)", stats.framesOut, stats.bytesOut,
+                         stats.seconds > 0 ? stats.framesOut / stats.seconds : 0.0);
+            for(auto& p : snap["phases"]) {
+                logger->info("  {:<24} n={:<8} p50={:.3f}ms p99={:.3f}ms max={:.3f}ms",
+                             p["name"].get<std::string>(), p["count"].get<uint64_t>(),
+                             p["p50_ms"].get<double>(), p["p99_ms"].get<double>(), p["max_ms"].get<double>());
+            }
+        }, boost::asio::detached);
+        co_await game_loop();
+    };
+
+    try {
+        init_game();
+    }
+    catch(std::exception& e) {
+        std::cerr << "Uncaught exception: " << e.what() << std::endl;
+        exit(1);
+    }
+    return 0;
+}
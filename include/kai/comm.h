@@ -47,4 +47,13 @@ void broadcast(const std::string& txt);
 
 boost::asio::awaitable<void> yield_for(std::chrono::milliseconds ms);
 
-void shutdown_game(int code);
\ No newline at end of file
+// The default game loop; a gameFunc can wrap it, as the replay driver does.
+boost::asio::awaitable<void> game_loop();
+
+void shutdown_game(int code);
+
+// Queues an action that touches state outside of the current input partition, which owns only
+// its views' zones and their characters' modules. While PlayViews
+// are being updated in parallel it runs on the game strand after all partitions finish;
+// otherwise it runs immediately.
+void defer_action(std::function<void()> action);
\ No newline at end of file
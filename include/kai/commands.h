@@ -0,0 +1,118 @@
+#pragma once
+#include "sysdep.h"
+#include <climits>
+#include <deque>
+
+namespace commands {
+
+    // A compressed (radix) prefix trie mapping case-insensitive keys to values. Besides exact
+    // lookups it answers Circle-style abbreviation lookups: the earliest-registered key that starts
+    // with the given prefix and is visible at the caller's level. Every node caches that answer
+    // per level threshold, so a lookup costs O(length of the key) no matter how many keys there are.
+    // Instantiated in commands.cpp for the value types used by the engine.
+    template<typename T>
+    class PrefixTrie {
+    public:
+        PrefixTrie() { nodes.emplace_back(); }
+
+        // Keys are matched case-insensitively. Re-inserting a key replaces its value and level
+        // but keeps its original order.
+        void insert(std::string_view key, T value, int level = 0);
+        void erase(std::string_view key);
+        void clear();
+
+        const T* exact(std::string_view key, int level = INT_MAX) const;
+        // An exact match wins; otherwise the earliest inserted key starting with prefix.
+        const T* abbreviation(std::string_view prefix, int level = INT_MAX) const;
+
+        [[nodiscard]] size_t size() const { return entries.size() - freeCount; }
+
+    private:
+        struct Best {
+            int level;
+            uint32_t order;
+            uint32_t entry;
+        };
+        struct Node {
+            std::string label;
+            std::vector<std::pair<char, uint32_t>> children;
+            int64_t entry{-1};
+            // sorted by level; order strictly decreases as level rises.
+            std::vector<Best> best;
+        };
+        struct Entry {
+            std::string key;
+            T value;
+            int level;
+            uint32_t order;
+            bool live;
+        };
+
+        static char lower(char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); }
+        int64_t findChild(uint32_t node, char c) const;
+        int64_t walk(std::string_view key, bool& partial) const;
+        const T* bestFor(uint32_t node, int level) const;
+        static void addBest(std::vector<Best>& best, Best b);
+        void link(uint32_t entry);
+        void rebuild();
+
+        std::vector<Node> nodes;
+        std::vector<Entry> entries;
+        size_t freeCount{0};
+        uint32_t nextOrder{0};
+    };
+
+    struct Command;
+
+    // The outcome of resolving one line of input. All views point into the input line (or the
+    // alias table), so the line must outlive the ParsedCommand.
+    struct ParsedCommand {
+        const Command *command{nullptr};
+        // set instead of command when the verb named one of the player's aliases.
+        const std::string *alias{nullptr};
+        std::string_view verb;
+        // everything after the verb, without leading whitespace.
+        std::string_view args;
+        // the first two words of args, as Circle's two_arguments() would split them.
+        std::string_view arg1, arg2;
+    };
+
+    using Handler = std::function<void(PlayView&, const ParsedCommand&)>;
+
+    struct Command {
+        std::string name;
+        Handler handler;
+        int minLevel{0};
+    };
+
+    // A player's aliases, compiled into the same trie structure as the command table.
+    class AliasTable {
+    public:
+        void set(std::string_view name, std::string expansion);
+        void remove(std::string_view name);
+        const std::string* find(std::string_view name) const;
+        [[nodiscard]] size_t size() const { return trie.size(); }
+    private:
+        PrefixTrie<std::string> trie;
+    };
+
+    class CommandRegistry {
+    public:
+        // Registration order matters: when an abbreviation matches several commands, the one
+        // added first wins, exactly as with Circle's cmd_info table.
+        const Command& add(std::string name, Handler handler, int minLevel = 0);
+        ParsedCommand resolve(std::string_view input, int level = 0, const AliasTable *aliases = nullptr) const;
+    private:
+        std::deque<Command> commands;
+        PrefixTrie<const Command*> trie;
+    };
+
+    extern CommandRegistry registry;
+
+    // Splits the next whitespace-delimited word off the front of text.
+    std::string_view nextWord(std::string_view& text);
+
+    // Circle-style alias expansion: ';' separates commands, $1-$9 are words of args and $* is
+    // all of args. Each resulting command is appended to out.
+    void expandAlias(std::string_view expansion, std::string_view args, std::list<std::string>& out);
+}
@@ -12,6 +12,10 @@ namespace config {
     extern int threadsCount;
     // This will be true if multithreading has been successfully engaged.
     extern bool usingMultithreading;
+    // If true (and multithreading is in use), PlayView input is processed in parallel, one
+    // strand per group of views sharing a zone or a character module. Changes to any other
+    // module must then go through defer_action().
+    extern bool parallelInput;
     // the duration - in milliseconds - between calls to the heartbeat.
     extern std::chrono::milliseconds heartbeatInterval;
 
@@ -24,7 +28,52 @@ namespace config {
     // the filename for the game save database.
     extern std::string assetDbName;
     extern std::string stateDbName;
+    // where boot_db() looks for module folders.
+    extern std::string modulesDirectory;
+    // threads used to load modules at boot. if set to <1, one per core.
+    extern int bootThreads;
+    // how often the persistence thread commits the snapshots handed to it...
+    extern std::chrono::milliseconds persistenceInterval;
+    // ...or sooner, once this many distinct objects are waiting.
+    extern size_t persistenceBatchSize;
+    // an object is saved whole again after this many delta saves, folding its field rows back in.
+    extern uint32_t deltaSavesPerFullSave;
+    // the estimated bytes of object contents paged modules may keep in memory before the least
+    // recently used objects are evicted. 0 turns paging off: modules are not paged by default.
+    extern int64_t residencyBudget;
+    // the bytes each module's objects may use before it is warned about and, if paged, has
+    // objects evicted. 0 means no limit; GameModule::getMemory().setLimit() overrides it.
+    extern int64_t moduleMemoryLimit;
+    // the shortest paths each graph::Graph remembers. 0 disables the cache.
+    extern size_t graphPathCacheSize;
+    // publish a read-only view of the world every tick for threads off the game strand; see
+    // readview.h.
+    extern bool readViews;
+    // the world snapshot written on a reboot and mapped by the next boot. empty disables it.
+    extern std::string snapshotFile;
+    // how many snapshot objects are loaded per tick until the world is fully resident.
+    extern size_t snapshotMaterializePerTick;
+    // pragmas applied to every SQLite connection; see storage::PragmaProfile.
+    extern std::string sqliteSynchronous;
+    extern int64_t sqliteMmapSize;
+    extern int64_t sqliteCacheSize;
+    // the journal of saves not yet committed to SQLite, written as numbered segments next to this
+    // path. empty disables it, and a crash loses up to persistenceInterval of saves.
+    extern std::string journalFile;
+    // a segment is closed and a new one started once it grows past this many bytes.
+    extern int64_t journalSegmentSize;
+    // how often the WAL is checkpointed in the background. 0 disables background checkpoints.
+    extern std::chrono::milliseconds walCheckpointInterval;
     extern bool logEgregiousTimings;
+    // the span of time the tick profiler's percentiles are computed over.
+    extern std::chrono::seconds profilerWindow;
+    // if set, the tick profiler writes every recorded phase to this file in Chrome trace format.
+    extern std::string profilerTraceFile;
+    // a tick running longer than this makes the watchdog log where the game strand is stuck.
+    // set to 0 to disable the watchdog.
+    extern std::chrono::milliseconds watchdogThreshold;
+    // if set, every frame received from Thermite is recorded to this file for later replay.
+    extern std::string linkRecordFile;
 
     extern bool testMode;
 }
@@ -7,3 +7,7 @@ extern std::shared_ptr<SQLite::Database> assetDb, stateDb, logDb;
 
 extern bool gameIsLoading;
 extern bool saveAll;
+
+// Loads every GameModule under config::modulesDirectory into gameModules. Modules are read in
+// parallel; references between objects are linked in a second pass once all of them exist.
+void boot_db();
@@ -0,0 +1,135 @@
+#pragma once
+#include "structs.h"
+#include <list>
+
+// Shortest paths over object relations, for track, mob pathing and speedwalk. A Graph follows a
+// chosen set of relations (usually the exits) and keeps them as compact CSR adjacency: one array
+// of edge offsets per node and one of edge targets. setRelation() and object removal patch the
+// graph as they happen: changed nodes get their edges from a small overlay until enough of them
+// piled up to rebuild the arrays, which also drops removed objects. Path results are cached, and
+// dropped when an edge they used goes away or an edge that was missing when they were found comes
+// (back), since it could make them shorter. Only loaded objects are in a graph.
+namespace graph {
+
+    struct Path {
+        // from the start to the goal, both included; empty when there is no path.
+        std::vector<ObjectLink> rooms;
+        // the relation followed out of every room but the last.
+        std::vector<symbols::Symbol> steps;
+
+        [[nodiscard]] bool found() const { return !rooms.empty(); }
+    };
+
+    // A lower bound on the steps from an object to the goal, which turns the search into A*.
+    using Heuristic = std::function<uint32_t(const GameObject& from, const GameObject& goal)>;
+
+    struct SearchOptions {
+        // give up on paths longer than this many steps.
+        uint32_t maxDepth{UINT32_MAX};
+        Heuristic heuristic;
+        // depth-limited searches are never cached. A* finds paths as short as BFS, so both share
+        // the cache.
+        bool useCache{true};
+    };
+
+    struct Stats {
+        size_t nodes{0}, edges{0}, overlayNodes{0}, cachedPaths{0};
+        uint64_t cacheHits{0}, cacheMisses{0}, rebuilds{0};
+    };
+
+    class Graph {
+    public:
+        // Follows the named relations of the objects of the named modules, or of every module when
+        // none are named. The graph is built right away.
+        explicit Graph(const std::vector<std::string>& relations, const std::vector<std::string>& modules = {});
+        ~Graph();
+        Graph(const Graph&) = delete;
+        Graph& operator=(const Graph&) = delete;
+
+        Path findPath(const GameObject& from, const GameObject& to, const SearchOptions& options = {});
+        // The first step of the shortest path, as track would show it; symbols::none when there is
+        // none or from is to.
+        symbols::Symbol nextStep(const GameObject& from, const GameObject& to, uint32_t maxDepth = UINT32_MAX);
+
+        // Rescans every object of the graph's modules. Never needed for correctness.
+        void rebuild();
+        [[nodiscard]] Stats stats() const;
+
+        // Called by GameObject and GameModule; see graph::relationChanged().
+        void onRelationChanged(const GameObject& obj, symbols::Symbol name);
+        void onRemoved(const GameObject& obj);
+
+    private:
+        struct Edge {
+            uint32_t target;
+            symbols::Symbol label;
+            bool operator==(const Edge&) const = default;
+        };
+        struct CachedPath {
+            uint64_t key;
+            uint64_t version;
+            std::vector<uint32_t> nodes;
+            std::vector<symbols::Symbol> steps;
+        };
+
+        bool covers(const GameModule* module) const;
+        bool watches(symbols::Symbol name) const;
+        uint32_t nodeFor(GameModule* module, const ObjectHandle& handle, bool create);
+        void edgesOf(const GameObject& obj, std::vector<Edge>& out);
+        std::span<const Edge> neighbours(uint32_t node) const;
+        void updateNode(const GameObject& obj);
+        void compact();
+        bool cacheValid(const CachedPath& entry) const;
+        void pruneGains();
+        Path toPath(const std::vector<uint32_t>& nodes, const std::vector<symbols::Symbol>& steps) const;
+        bool search(uint32_t from, uint32_t to, const SearchOptions& options, const GameObject& goal,
+                    std::vector<uint32_t>& nodes, std::vector<symbols::Symbol>& steps);
+
+        std::vector<symbols::Symbol> relations;
+        // empty means every module.
+        std::vector<const GameModule*> modules;
+
+        mutable std::mutex mutex;
+        std::vector<ObjectLink> nodes;
+        std::vector<bool> dead;
+        // node by object slot, per module.
+        std::unordered_map<const GameModule*, std::vector<uint32_t>> nodeBySlot;
+
+        // CSR over the first csrNodes nodes.
+        uint32_t csrNodes{0};
+        std::vector<uint32_t> offsets;
+        std::vector<Edge> edges;
+        // nodes whose edges changed since the last compaction, and nodes added since.
+        std::unordered_map<uint32_t, std::vector<Edge>> overlay;
+        std::vector<bool> patched;
+
+        // Cache invalidation: every change bumps version. A node remembers when it last lost an
+        // edge, which breaks the paths through it. A gained edge can only shorten paths found
+        // while it was missing: a door that opens again spoils the paths found while it was shut,
+        // recorded as the interval [since, to) in gains. An edge never seen before spoils every
+        // path found before it, through lastAddition.
+        uint64_t version{1};
+        uint64_t lastAddition{0};
+        std::vector<uint64_t> lostEdgeAt;
+        struct Gap {
+            Edge edge;
+            uint64_t since;
+        };
+        // edges lost by each node and not regained yet.
+        std::unordered_map<uint32_t, std::vector<Gap>> gaps;
+        std::vector<std::pair<uint64_t, uint64_t>> gains;
+        std::list<CachedPath> lru;
+        std::unordered_map<uint64_t, std::list<CachedPath>::iterator> cache;
+        uint64_t cacheHits{0}, cacheMisses{0}, rebuilds{0};
+
+        // search scratch, reused between queries.
+        std::vector<uint32_t> visitMark, parent, distance;
+        std::vector<symbols::Symbol> parentLabel;
+        uint32_t visitStamp{0};
+    };
+
+    // Hooks for GameObject::setRelation() and GameModule::removeGameObject(); they forward to
+    // every live Graph interested in the change.
+    void relationChanged(const GameObject& obj, symbols::Symbol name);
+    void objectRemoved(const GameObject& obj);
+}
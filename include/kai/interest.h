@@ -0,0 +1,45 @@
+#pragma once
+#include "structs.h"
+
+// Interest management: who hears what happens where. Every PlayView observes the object its
+// character is in and, through the containment hierarchy, every container above that (the room,
+// the area holding the room, and so on) as well as the module the room belongs to. Moving a
+// character, or a container with characters inside, updates only the levels that changed, so
+// room, area, zone and channel messages reach their recipients without looking at anyone else.
+//
+// Delivery only appends to the views' output. From a parallel input partition, messages for a
+// room in a zone the partition owns can be sent directly; zone-wide and channel messages reach
+// views in other partitions and go through defer_action().
+namespace interest {
+
+    // Starts tracking where body is on behalf of view; observing another body replaces the first.
+    // PlayView observes its character when constructed and forgets itself when destroyed.
+    void observe(PlayView& view, const GameObject& body);
+    void forget(PlayView& view);
+
+    // Channels are plain names; a view hears every channel it joined, wherever it is.
+    void join(PlayView& view, std::string_view channel);
+    void leave(PlayView& view, std::string_view channel);
+
+    // The views whose characters are directly inside place, anywhere inside it, in a zone, or on a
+    // channel. Unordered.
+    std::vector<PlayView*> inside(const GameObject& place);
+    std::vector<PlayView*> within(const GameObject& place);
+    std::vector<PlayView*> inZone(const GameModule& zone);
+    std::vector<PlayView*> onChannel(std::string_view channel);
+
+    // Send txt to those same views, skipping except, and return how many were sent to.
+    size_t sendInside(const GameObject& place, const std::string& txt, const PlayView* except = nullptr);
+    size_t sendWithin(const GameObject& place, const std::string& txt, const PlayView* except = nullptr);
+    size_t sendToZone(const GameModule& zone, const std::string& txt, const PlayView* except = nullptr);
+    size_t sendToChannel(std::string_view channel, const std::string& txt, const PlayView* except = nullptr);
+
+    struct Stats {
+        size_t observers{0}, places{0}, zones{0}, channels{0};
+    };
+    Stats stats();
+
+    // Hooks for GameObject: the object moved, or is leaving its module.
+    void parentChanged(const GameObject& obj);
+    void objectRemoved(const GameObject& obj);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "storage.h"
+
+// An append-only log of everything persistence is handed, so that a crash loses at most the
+// tick in progress instead of whatever the SQLite writer had not committed yet.
+//
+// Every tick's batch becomes one checksummed frame. A background thread appends the frames and
+// syncs once per group of frames that arrived together (group commit), so the game thread never
+// waits on the disk. The SQLite writer is the compactor: once it has committed a batch, the
+// segments holding nothing newer are deleted. At boot, whatever is left is replayed into SQLite
+// before the modules load.
+namespace journal {
+    using storage::ObjectRecord;
+
+    // Persistence: opens a fresh segment next to path and starts the sync thread.
+    void open(const std::string& path);
+    // Syncs and stops the thread. Segments go away only if everything in them was committed.
+    void close();
+    bool isOpen();
+
+    // Game thread, once per tick: encodes the batch for seq. Call before the records are moved.
+    std::string encode(const std::vector<ObjectRecord>& batch);
+    void append(uint64_t seq, std::string payload);
+    // Persistence writer: everything up to and including seq is in SQLite.
+    void release(uint64_t seq);
+
+    // Boot: writes the frames of a previous run into store, oldest first, and deletes their
+    // segments. A torn or corrupt frame ends its segment. Returns the number of records.
+    size_t replay(const std::string& path, storage::Store& store);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "sysdep.h"
+#include "nlohmann/json.hpp"
+#include <atomic>
+#include <memory_resource>
+
+// Per-module memory. Each GameModule allocates its objects, and the vectors inside them, from its
+// own pool, so a long uptime fragments one module's pool instead of the global heap, threads
+// working on different modules never contend on an allocator, and the memory of every module
+// can be counted and capped.
+namespace memory {
+
+    struct Stats {
+        // what the module's objects hold right now, and the most they ever held.
+        int64_t bytes{0}, peakBytes{0};
+        // what the pool took from the system heap to serve them; the rest is fragmentation and
+        // free lists.
+        int64_t reservedBytes{0};
+        int64_t allocations{0}, totalAllocations{0};
+        // 0 when uncapped.
+        int64_t limit{0};
+    };
+
+    class ModuleResource : public std::pmr::memory_resource {
+    public:
+        explicit ModuleResource(std::string name);
+        ~ModuleResource() override;
+
+        [[nodiscard]] Stats stats() const;
+        // Soft: allocations never fail, but a module over its limit is warned about, and a paged
+        // one has its least recently used objects evicted (see residency::evict()). -1 follows
+        // config::moduleMemoryLimit, 0 turns the cap off.
+        void setLimit(int64_t bytes);
+        [[nodiscard]] int64_t limit() const;
+        [[nodiscard]] bool overLimit() const;
+        [[nodiscard]] int64_t bytes() const { return m_bytes.load(std::memory_order_relaxed); }
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        // Counts what the pool takes from the heap.
+        class Upstream : public std::pmr::memory_resource {
+        public:
+            std::atomic<int64_t> reserved{0};
+        private:
+            void* do_allocate(size_t bytes, size_t alignment) override;
+            void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+        };
+
+        std::string m_name;
+        Upstream m_upstream;
+        std::pmr::synchronized_pool_resource m_pool;
+        std::atomic<int64_t> m_bytes{0}, m_peak{0}, m_allocations{0}, m_totalAllocations{0};
+        std::atomic<int64_t> m_limit{-1};
+        // so crossing the limit is logged once, not on every allocation.
+        std::atomic<bool> m_warned{false};
+    };
+
+    // An allocator that keeps its resource alive. Objects are allocated with it through
+    // allocate_shared(), so a shared_ptr that outlives its module still has a pool to go back to.
+    template<typename T>
+    class Allocator {
+    public:
+        using value_type = T;
+
+        explicit Allocator(std::shared_ptr<ModuleResource> resource) : resource(std::move(resource)) {}
+        template<typename U>
+        Allocator(const Allocator<U>& other) : resource(other.resource) {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(resource->allocate(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T* p, size_t n) {
+            resource->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        template<typename U>
+        bool operator==(const Allocator<U>& other) const { return resource == other.resource; }
+
+    private:
+        template<typename U> friend class Allocator;
+        std::shared_ptr<ModuleResource> resource;
+    };
+
+    // Every loaded module's stats, for admin tooling.
+    nlohmann::json snapshot();
+}
@@ -27,7 +27,6 @@ namespace net {
         awaitable<void> runReader();
         awaitable<void> runWriter();
         awaitable<void> runPinger();
-        awaitable<void> createUpdateClient(const nlohmann::json &j);
         boost::beast::websocket::stream<boost::beast::tcp_stream> conn;
         bool is_stopped;
     };
@@ -63,6 +62,9 @@ namespace net {
 
     awaitable<void> runLinkManager();
 
+    // Dispatches one frame received from Thermite (client_list, client_ready, client_data...).
+    awaitable<void> routeLinkMessage(nlohmann::json &j);
+
     enum class Protocol : uint8_t {
         Telnet = 0,
         WebSocket = 1
@@ -0,0 +1,32 @@
+#pragma once
+#include "structs.h"
+#include "storage.h"
+
+namespace persistence {
+    using storage::ObjectRecord;
+
+    // Opens the writer's own connection to the asset database and starts the writer and
+    // checkpoint threads.
+    void start();
+    // Flushes everything that was handed off and stops the writer thread.
+    void stop();
+
+    // Game thread: snapshots every dirty object of every module and hands them to the writer.
+    void processDirty();
+
+    // Queues a batch for the writer. Never blocks on SQLite.
+    void submit(std::vector<ObjectRecord> batch);
+
+    // True when nothing of this object is waiting to be written, so the database has its latest
+    // handed-off state.
+    bool isSettled(const std::string& module, int64_t id);
+
+    // Blocks until everything submitted so far has been committed. Returns false, with an error
+    // logged, if the writer failed several times in a row meanwhile or was stopped first; the
+    // writer keeps retrying on its own.
+    bool flush();
+
+    // Marks everything dirty, hands it off and waits for the writer to commit it. Returns what
+    // flush() returned.
+    bool saveAll();
+}
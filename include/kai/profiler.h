@@ -0,0 +1,110 @@
+#pragma once
+#include "sysdep.h"
+#include "nlohmann/json.hpp"
+#include <atomic>
+#include <pthread.h>
+
+namespace profiler {
+    // Phases are registered once (usually at static-init time) and referred to by id afterwards,
+    // so recording a sample never touches a string.
+    using PhaseId = uint16_t;
+    constexpr PhaseId maxPhases = 256;
+    constexpr PhaseId invalidPhase = UINT16_MAX;
+
+    enum class PhaseKind : uint8_t {
+        Phase = 0,
+        System = 1
+    };
+
+    PhaseId registerPhase(const std::string& name, PhaseKind kind = PhaseKind::Phase);
+    const std::string& phaseName(PhaseId id);
+    PhaseKind phaseKind(PhaseId id);
+
+    // nanoseconds on the steady clock.
+    inline int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // A log-linear (HDR-style) histogram of nanosecond durations. Each power of two is split into
+    // 16 linear sub-buckets, which keeps the relative error of any percentile under ~6%.
+    class Histogram {
+    public:
+        static constexpr int subBucketBits = 4;
+        static constexpr int subBuckets = 1 << subBucketBits;
+        static constexpr int maxExponent = 43; // ~2.4 hours in nanoseconds; anything larger is clamped.
+        static constexpr int bucketCount = (maxExponent - subBucketBits + 2) * subBuckets;
+
+        void record(int64_t value);
+        void merge(const Histogram& other);
+        void reset();
+        [[nodiscard]] int64_t percentile(double p) const;
+        [[nodiscard]] uint64_t count() const { return total; }
+        [[nodiscard]] int64_t max() const { return maxValue; }
+
+        static int bucketFor(int64_t value);
+        static int64_t valueFor(int bucket);
+    private:
+        std::array<uint32_t, bucketCount> buckets{};
+        uint64_t total{0};
+        int64_t maxValue{0};
+    };
+
+    // A histogram over a sliding window made of a few slots which are recycled as time passes.
+    class RollingHistogram {
+    public:
+        static constexpr int slotCount = 6;
+        void record(int64_t value, int64_t timestamp);
+        [[nodiscard]] Histogram merged() const;
+    private:
+        void rotate(int64_t timestamp);
+        std::array<Histogram, slotCount> slots{};
+        int current{0};
+        int64_t slotStart{0};
+    };
+
+    // Where the game strand currently is. Written by Scopes on the game strand and by
+    // beginTick()/endTick(), read from other threads by the watchdog.
+    struct Marker {
+        std::atomic<uint64_t> tick{0};
+        std::atomic<int64_t> tickStart{0};
+        std::atomic<PhaseId> phase{invalidPhase};
+        std::atomic<PhaseId> system{invalidPhase};
+        std::atomic<int64_t> phaseStart{0};
+        // the executor thread that last entered a Scope; the strand may hop threads between ticks.
+        std::atomic<pthread_t> thread{};
+    };
+    extern Marker marker;
+
+    // RAII helper that records the time spent in its scope against a phase. Scopes are meant
+    // for the game strand, since they also move the Marker; other threads should call record().
+    class Scope {
+    public:
+        explicit Scope(PhaseId phase);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        PhaseId phase;
+        PhaseId previous;
+        int64_t start;
+    };
+
+    // Records a finished sample into the calling thread's buffer. Never blocks or allocates
+    // once the thread's buffer exists.
+    void record(PhaseId phase, int64_t start, int64_t duration);
+
+    // Called by the game loop around every tick. endTick() drains all thread buffers into the
+    // histograms, so it must only be called from the game strand.
+    void beginTick();
+    void endTick();
+
+    // Logs the phases recorded during the last tick, slowest first.
+    void logLastTick();
+
+    // p50/p99/max for every phase over the rolling window, for admin queries.
+    nlohmann::json snapshot();
+
+    // Chrome trace-event output (chrome://tracing, Perfetto). Empty path disables it.
+    void openTrace(const std::string& path);
+    void closeTrace();
+}
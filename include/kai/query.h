@@ -0,0 +1,84 @@
+#pragma once
+#include "structs.h"
+#include <variant>
+
+struct lua_State;
+
+// Secondary indexes over object attributes. An index covers one attribute (stats or strings,
+// category, name) of the objects of one module and is kept up to date on every set, load and
+// removal, so searches such as "every object with vnum 3001" or "every player in clan Y" cost
+// one hash or tree lookup instead of a scan. Only loaded objects are indexed: in a paged module,
+// objects that were never loaded are not found, while evicted ones keep their entries.
+//
+// A module declares its indexes in indexes.json in its folder, an array of
+//   {"field": "stats"|"strings", "category": ..., "name": ..., "kind": "hash"|"ordered"}
+// ("kind" defaults to hash), created at boot once every object is loaded. Scripts can add and
+// drop indexes at run time through the query table.
+namespace query {
+
+    enum class IndexKind : uint8_t {
+        // equality only.
+        Hash = 0,
+        // equality and ranges, in value order.
+        Ordered = 1
+    };
+
+    using Value = std::variant<double, std::string>;
+
+    // Which attribute of an object a query looks at.
+    struct Attribute {
+        ObjectField field{ObjectField::Stats};
+        symbols::Symbol category{symbols::none};
+        symbols::Symbol name{symbols::none};
+
+        Attribute() = default;
+        Attribute(ObjectField field, const std::string& category, const std::string& name);
+        bool operator==(const Attribute&) const = default;
+    };
+
+    class Index {
+    public:
+        Index(Attribute attribute, IndexKind kind) : attribute(attribute), kind(kind) {}
+        virtual ~Index() = default;
+        [[nodiscard]] const Attribute& getAttribute() const { return attribute; }
+        [[nodiscard]] IndexKind getKind() const { return kind; }
+
+        // Records the object's current value; nullptr when it has none.
+        virtual void assign(const ObjectHandle& handle, const Value* value) = 0;
+        virtual void erase(const ObjectHandle& handle) = 0;
+
+        virtual void equal(const Value& value, std::vector<ObjectHandle>& out) const = 0;
+        // Inclusive bounds; a missing bound is open. Only ordered indexes answer ranges.
+        virtual bool range(const std::optional<Value>& low, const std::optional<Value>& high, std::vector<ObjectHandle>& out) const = 0;
+        [[nodiscard]] virtual size_t size() const = 0;
+
+    protected:
+        Attribute attribute;
+        IndexKind kind;
+    };
+
+    std::unique_ptr<Index> makeIndex(Attribute attribute, IndexKind kind);
+
+    // Creates the indexes of an indexes.json array on module, warning about and skipping
+    // malformed entries. Returns how many were created.
+    size_t createIndexes(GameModule& module, const nlohmann::json& definitions);
+
+    // The value of an attribute on a loaded object, if it has one.
+    std::optional<Value> valueOf(const GameObject& obj, const Attribute& attribute);
+
+    // The objects of a module whose attribute equals value, or lies between low and high. These
+    // use the module's index on the attribute and fall back to a scan of the module without one
+    // (or, for a range, without an ordered one).
+    std::vector<ObjectHandle> find(GameModule& module, const Attribute& attribute, const Value& value);
+    std::vector<ObjectHandle> range(GameModule& module, const Attribute& attribute,
+                                    const std::optional<Value>& low, const std::optional<Value>& high);
+
+    // Installs the query table in a Luau state:
+    //   query.find(module, "stats"|"strings", category, name, value)
+    //   query.range(module, "stats"|"strings", category, name, low, high)
+    // return arrays of {module=, id=, generation=}. A nil module searches every module.
+    //   query.createIndex(module, "stats"|"strings", category, name, "hash"|"ordered")
+    //   query.dropIndex(module, "stats"|"strings", category, name, "hash"|"ordered")
+    // need a module; the kind defaults to hash. dropIndex returns whether there was one.
+    void registerLua(lua_State *L);
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "structs.h"
+
+// Read views: immutable copies of world state for threads other than the game strand, such as a
+// who-list, a web API or a metrics exporter. At the end of every tick the game thread publishes a
+// new view. Only the objects that changed during the tick are copied; everything else is shared
+// with the previous view. A reader pins the newest view with a Reader and can then walk it
+// without locks or reference counting, for as long as it likes. Views are reclaimed by the game
+// thread once no reader can still see them, so a slow reader costs memory, never tick time.
+namespace readview {
+
+    struct Ref {
+        std::string module;
+        int64_t id{0};
+        int64_t generation{0};
+    };
+
+    // An object as it was when the view was published.
+    struct ObjectView {
+        int64_t id{0};
+        int64_t generation{0};
+        std::optional<Ref> parent, owner;
+        std::vector<std::pair<std::string, Ref>> relations;
+        AttributeManager<double> stats;
+        AttributeManager<std::string> strings;
+    };
+
+    // Objects are filed by id in fixed-size chunks, so publishing a change copies one chunk of
+    // pointers rather than the whole module.
+    constexpr int chunkBits = 8;
+    struct Chunk {
+        std::array<std::shared_ptr<const ObjectView>, 1 << chunkBits> objects;
+    };
+
+    struct ModuleView {
+        std::string name;
+        size_t objectCount{0};
+        std::vector<std::shared_ptr<const Chunk>> chunks;
+
+        const ObjectView* find(int64_t id) const;
+        // In id order.
+        template<typename F>
+        void forEach(F&& fn) const {
+            for(auto& chunk : chunks) {
+                if(!chunk) continue;
+                for(auto& obj : chunk->objects) {
+                    if(obj) fn(*obj);
+                }
+            }
+        }
+    };
+
+    struct WorldView {
+        // the tick this view was published at; increases with every view.
+        uint64_t tick{0};
+        // sorted by name.
+        std::vector<std::shared_ptr<const ModuleView>> modules;
+
+        const ModuleView* module(std::string_view name) const;
+        const ObjectView* find(std::string_view module, int64_t id) const;
+    };
+
+    // Turns publishing on. Until then, nothing is copied and modules do not track changes for it.
+    // The first view is a full copy of every loaded object; in a paged module, objects show up
+    // once they are loaded.
+    void enable();
+    bool enabled();
+
+    // Game thread, once per tick: publishes what changed since the last call, and frees the views
+    // no reader can see anymore.
+    void publish();
+
+    // Pins the newest view until destroyed. Any thread may hold one, and they nest; a thread can
+    // not hand its Reader to another one. Returns nullptr from view() before the first publish.
+    class Reader {
+    public:
+        Reader();
+        ~Reader();
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        const WorldView* view() const { return current; }
+
+    private:
+        const WorldView* current{nullptr};
+    };
+
+    // How many views are waiting for readers to let go of them.
+    size_t retiredCount();
+
+    // Stops publishing and frees every view, waiting briefly for readers still holding one; a
+    // view still read after that is leaked rather than freed under its reader. Called at shutdown.
+    void shutdown();
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "net.h"
+#include <fstream>
+
+namespace net {
+    // Recordings start with this magic, followed by one record per inbound Link frame:
+    // a varint of microseconds since the previous frame, a varint length, then the frame text.
+    constexpr std::string_view recordingMagic = "KAIREC01";
+
+    class LinkRecorder {
+    public:
+        explicit LinkRecorder(const std::string& path);
+        ~LinkRecorder();
+        void record(std::string_view frame);
+    private:
+        std::ofstream out;
+        std::string buffer;
+        std::chrono::steady_clock::time_point last;
+        std::mutex mutex;
+    };
+
+    class LinkRecording {
+    public:
+        explicit LinkRecording(const std::string& path);
+        // Returns false at the end of the file.
+        bool next(std::chrono::microseconds& delay, std::string& frame);
+    private:
+        std::ifstream in;
+    };
+
+    // Set when config::linkRecordFile is non-empty; Link::runReader() hands it every frame.
+    extern std::unique_ptr<LinkRecorder> recorder;
+
+    struct ReplayStats {
+        uint64_t framesIn{0}, bytesIn{0};
+        uint64_t framesOut{0}, bytesOut{0};
+        double seconds{0.0};
+    };
+
+    // Feeds a recording into net::connections exactly as a Link would. When realtime is false
+    // frames are routed as fast as the connection channels accept them. Meant to be used from a
+    // gameFunc, next to game_loop(); it shuts the game down once the recording is exhausted.
+    awaitable<ReplayStats> replayLink(std::string path, bool realtime);
+}
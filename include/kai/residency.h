@@ -0,0 +1,31 @@
+#pragma once
+#include "structs.h"
+
+// Paged residency: GameModules that are paged only keep the objects that are in use fully in
+// memory. Every other object is a shell holding its identity and reverse relations, so that
+// weak_ptrs to it stay valid, and its contents are read back from the database the next time
+// they are touched.
+namespace residency {
+    // Advanced once per tick; objects remember the value from when they were last touched.
+    extern std::atomic<uint64_t> clock;
+
+    // The estimated memory held by the contents of resident objects of paged modules.
+    extern std::atomic<int64_t> residentBytes;
+
+    // Reads an object's saved contents into it. Returns false if it was never saved.
+    bool load(GameObject& obj);
+
+    // Looks up the generation of a saved object that is not in memory yet.
+    std::optional<int64_t> savedGeneration(const std::string& module, int64_t id);
+
+    // The highest id saved for a module, so new objects of a paged module never reuse one.
+    int64_t savedMaxId(const std::string& module);
+
+    // Game thread, once per tick after the dirty objects were handed to persistence: evicts the
+    // least recently touched clean objects while over config::residencyBudget, and those of any
+    // paged module over its memory limit (see memory.h) while it is.
+    void evict();
+
+    // Drops the read connection; called at shutdown.
+    void close();
+}
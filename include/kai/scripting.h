@@ -5,6 +5,7 @@
 #include "luacode.h"
 #include "LuaBridge/LuaBridge.h"
 #include "structs.h"
+#include <atomic>
 
 namespace script {
 
@@ -33,15 +34,24 @@ namespace script {
         TaskState state{Created};
     };
 
+    // The first line of the script Task::run() is executing, if any. The watchdog reads this from
+    // its own thread; it is an owned copy, so it stays valid however long the task lives.
+    extern std::atomic<std::shared_ptr<const std::string>> runningScript;
+    // When set, the next Luau interrupt on the running thread logs the Lua call stack.
+    extern std::atomic<bool> tracebackRequested;
+
     class ScriptManager {
     public:
         ScriptManager();
         CompiledScript compile(const std::string& source);
         lua_State *createThread();
+        // Drops the registry reference which keeps a thread from createThread() alive.
+        void releaseThread(lua_State *thread);
 
     private:
         lua_State *L;
         std::unordered_map<std::string, std::shared_ptr<std::string>> compiled;
+        std::unordered_map<lua_State*, int> threads;
 
     };
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+#pragma once
+#include "sysdep.h"
+#include "nlohmann/json.hpp"
+
+// A compact, versioned binary encoding for saved game data.
+//
+// A blob is: a magic byte, a kind byte, a varint format version, the key table (a varint count
+// followed by that many strings), then the body. Every repeated name - relation names, attribute
+// categories and names, module names in references - is written once into the key table and
+// referred to by its index afterwards. Bodies are sequences of tagged, length-delimited fields,
+// so a reader skips the fields it does not know and old blobs stay readable as fields are added.
+namespace serial {
+    constexpr uint8_t magic = 0xB7;
+
+    enum class Kind : uint8_t {
+        GameObject = 1,
+        Attributes = 2,
+        // one tick's worth of ObjectRecords in the journal.
+        JournalBatch = 3
+    };
+
+    // One changed field of a saved object, as written by delta saves. field is the object's field
+    // tag, category and name say which entry of it changed (empty where they do not apply), and
+    // value is the entry's bare encoding, or empty when the entry was removed.
+    struct FieldChange {
+        uint32_t field{0};
+        std::string category;
+        std::string name;
+        std::optional<std::string> value;
+    };
+
+    class Error : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    void appendVarint(std::string& out, uint64_t value);
+
+    inline uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    inline int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+
+    class Writer {
+    public:
+        void u8(uint8_t value) { body.push_back(static_cast<char>(value)); }
+        void varint(uint64_t value) { appendVarint(body, value); }
+        void svarint(int64_t value) { varint(zigzag(value)); }
+        void f64(double value);
+        void str(std::string_view value);
+        // An interned name: written once into the key table, as an index everywhere else.
+        void key(std::string_view name);
+
+        // Fields are written in place without their lengths; endField() notes the length and
+        // finish() writes it in front of the field, so closing a field never moves the body.
+        size_t beginField(uint32_t tag);
+        void endField(size_t mark);
+
+        // Assembles the blob. The Writer is empty afterwards and may be reused.
+        std::string finish(Kind kind, uint32_t version);
+        // Just the body, for small values that never use key().
+        std::string finishBare();
+
+    private:
+        struct Field {
+            // where the field's contents start in body, and how long they are.
+            size_t start;
+            uint64_t length;
+        };
+        void writeBody(std::string& out) const;
+
+        std::string body;
+        std::vector<Field> fields;
+        std::vector<std::string> keys;
+        std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>> keyIndex;
+    };
+
+    class Reader {
+    public:
+        Reader() = default;
+        // Reads and checks the header; throws Error when the blob is not of the given kind.
+        Reader(std::string_view blob, Kind kind);
+        // Reads a body written by Writer::finishBare().
+        explicit Reader(std::string_view body) : data(body) {}
+
+        [[nodiscard]] uint32_t version() const { return formatVersion; }
+        [[nodiscard]] bool atEnd() const { return pos == data.size(); }
+
+        uint8_t u8();
+        uint64_t varint();
+        int64_t svarint() { return unzigzag(varint()); }
+        double f64();
+        std::string_view str();
+        std::string_view key();
+
+        // Moves to the next field, returning false at the end of the current body. The field's
+        // payload is read through the returned Reader.
+        bool nextField(uint32_t& tag, Reader& field);
+
+    private:
+        Reader(std::string_view data, std::shared_ptr<std::vector<std::string_view>> keys, uint32_t version)
+            : data(data), keys(std::move(keys)), formatVersion(version) {}
+        std::string_view take(size_t count);
+
+        std::string_view data;
+        size_t pos{0};
+        // shared with the Readers of nested fields.
+        std::shared_ptr<std::vector<std::string_view>> keys;
+        uint32_t formatVersion{0};
+    };
+
+    // Values of an AttributeManager<T>. Anything that is not a number or a string is stored as
+    // MessagePack, which round-trips every type nlohmann::json can convert.
+    template<typename T>
+    void writeValue(Writer& w, const T& value) {
+        if constexpr (std::is_same_v<T, bool>) w.u8(value ? 1 : 0);
+        else if constexpr (std::is_integral_v<T>) w.svarint(static_cast<int64_t>(value));
+        else if constexpr (std::is_floating_point_v<T>) w.f64(static_cast<double>(value));
+        else if constexpr (std::is_same_v<T, std::string>) w.str(value);
+        else {
+            auto packed = nlohmann::json::to_msgpack(nlohmann::json(value));
+            w.str(std::string_view(reinterpret_cast<const char*>(packed.data()), packed.size()));
+        }
+    }
+
+    template<typename T>
+    T readValue(Reader& r) {
+        if constexpr (std::is_same_v<T, bool>) return r.u8() != 0;
+        else if constexpr (std::is_integral_v<T>) return static_cast<T>(r.svarint());
+        else if constexpr (std::is_floating_point_v<T>) return static_cast<T>(r.f64());
+        else if constexpr (std::is_same_v<T, std::string>) return T(r.str());
+        else {
+            auto packed = r.str();
+            return nlohmann::json::from_msgpack(packed.begin(), packed.end()).template get<T>();
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "sysdep.h"
+
+// A generational slot map: values live densely in one vector, and a Handle finds its value
+// through a slot table in O(1). Erasing moves the last value into the hole, so iteration is
+// always over a packed array, in no particular order. Every slot carries a version that changes
+// whenever its value is erased, so a handle that outlived its value resolves to nothing instead
+// of to whatever took the slot over.
+template<typename T>
+class SlotMap {
+public:
+    static constexpr uint32_t invalidIndex = UINT32_MAX;
+
+    // Trivially copyable; resolving one costs two array reads.
+    struct Handle {
+        uint32_t index{invalidIndex};
+        uint32_t version{0};
+
+        explicit operator bool() const { return index != invalidIndex; }
+        bool operator==(const Handle&) const = default;
+    };
+
+    Handle insert(T value) {
+        uint32_t index;
+        if(freeHead != invalidIndex) {
+            index = freeHead;
+            freeHead = slots[index].dense;
+        } else {
+            index = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
+        }
+        auto& slot = slots[index];
+        // odd versions are live.
+        slot.version++;
+        slot.dense = static_cast<uint32_t>(values.size());
+        values.push_back(std::move(value));
+        owners.push_back(index);
+        return Handle{index, slot.version};
+    }
+
+    bool erase(Handle h) {
+        if(!contains(h)) return false;
+        auto& slot = slots[h.index];
+        auto hole = slot.dense;
+        if(hole != values.size() - 1) {
+            values[hole] = std::move(values.back());
+            owners[hole] = owners.back();
+            slots[owners[hole]].dense = hole;
+        }
+        values.pop_back();
+        owners.pop_back();
+        slot.version++;
+        slot.dense = freeHead;
+        freeHead = h.index;
+        return true;
+    }
+
+    [[nodiscard]] bool contains(Handle h) const {
+        return h.index < slots.size() && slots[h.index].version == h.version && (h.version & 1);
+    }
+
+    T* get(Handle h) {
+        return contains(h) ? &values[slots[h.index].dense] : nullptr;
+    }
+
+    const T* get(Handle h) const {
+        return contains(h) ? &values[slots[h.index].dense] : nullptr;
+    }
+
+    void reserve(size_t count) {
+        values.reserve(count);
+        owners.reserve(count);
+        slots.reserve(count);
+    }
+
+    [[nodiscard]] size_t size() const { return values.size(); }
+    [[nodiscard]] bool empty() const { return values.empty(); }
+
+    auto begin() { return values.begin(); }
+    auto end() { return values.end(); }
+    auto begin() const { return values.begin(); }
+    auto end() const { return values.end(); }
+
+private:
+    struct Slot {
+        uint32_t version{0};
+        // the value's index in values while live, the next free slot otherwise.
+        uint32_t dense{invalidIndex};
+    };
+
+    std::vector<T> values;
+    // the slot each value belongs to, so erase can repoint the value it moves.
+    std::vector<uint32_t> owners;
+    std::vector<Slot> slots;
+    uint32_t freeHead{invalidIndex};
+};
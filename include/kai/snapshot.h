@@ -0,0 +1,38 @@
+#pragma once
+#include "structs.h"
+#include "storage.h"
+
+// A memory-mappable image of the world, written when the game shuts down for a reboot. The next
+// boot maps it and creates every object as a shell whose contents decode straight out of the
+// mapping on first use, instead of reading and decoding the whole world from SQLite.
+//
+// A snapshot is only trusted while the database still carries its token: the token is written
+// after the snapshot file is complete and removed as soon as persistence starts writing again,
+// so a crash or any later save makes the snapshot stale and boot falls back to SQLite.
+namespace snapshot {
+    // Writes every module to path (through a temporary file and a rename) and records its token
+    // in the database. Persistence must be stopped, so the database is final.
+    void write(const std::string& path);
+
+    // Maps the snapshot at path if it matches the database. Returns false if there is none or
+    // it is stale, in which case nothing was mapped.
+    bool open(const std::string& path);
+    bool isOpen();
+    void close();
+    // Makes any snapshot written so far unusable, before the database changes under it.
+    void markStale(storage::Store& store);
+
+    // Boot: creates the modules held by the snapshot, filled with shells. Returns their names.
+    std::set<std::string> createModules();
+
+    // The saved encoding of an object, if the snapshot has it and it has not been saved since.
+    std::optional<std::string_view> find(const std::string& module, int64_t id, int64_t generation);
+
+    // Called for every object handed to persistence; its snapshot entry is stale from now on.
+    void invalidate(const std::string& module, int64_t id);
+
+    // Game thread, once per tick: loads up to budget more shells of non-paged modules, so the
+    // world is fully resident (with complete reverse relations) soon after boot. The mapping is
+    // released once nothing can read from it anymore.
+    void materialize(size_t budget);
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "sysdep.h"
+#include "SQLiteCpp/SQLiteCpp.h"
+#include "serialization.h"
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+namespace storage {
+    // One object's saved state, captured on the game thread. The storage layer only ever sees
+    // these snapshots, never the live GameObject.
+    //
+    // A full record replaces the object's blob and drops its field rows. Otherwise only the
+    // changed fields are written, as rows that override the blob until the next full save.
+    struct ObjectRecord {
+        std::string module;
+        int64_t id{0};
+        int64_t generation{0};
+        bool full{true};
+        std::string data;
+        std::vector<serial::FieldChange> fields;
+        bool deleted{false};
+    };
+
+    // Folds newer into older, leaving what a single record for the object has to write. A later
+    // full record replaces what was there, later deltas are appended.
+    void merge(ObjectRecord& older, ObjectRecord&& newer);
+
+    // The pragmas applied to every connection when it is opened.
+    struct PragmaProfile {
+        std::string journalMode{"WAL"};
+        // OFF, NORMAL, FULL or EXTRA. NORMAL is durable across application crashes in WAL mode.
+        std::string synchronous{"NORMAL"};
+        int64_t mmapSize{0};
+        // as for PRAGMA cache_size: positive is pages, negative is KiB.
+        int64_t cacheSize{-2000};
+        int busyTimeoutMs{5000};
+        // 0 leaves checkpoints entirely to the Checkpointer.
+        int walAutoCheckpoint{0};
+    };
+
+    // The profile built from the config:: settings.
+    PragmaProfile defaultProfile();
+    void applyProfile(SQLite::Database& db, const PragmaProfile& profile);
+
+    // Queries are registered once, usually at static-init time, and referred to by id afterwards.
+    using QueryId = uint16_t;
+    QueryId registerQuery(std::string sql);
+    const std::string& querySql(QueryId id);
+
+    // A connection together with its compiled statements. Not thread-safe; each thread that
+    // talks to SQLite owns its own Store.
+    class Store {
+    public:
+        explicit Store(const std::string& path, const PragmaProfile& profile = defaultProfile());
+
+        SQLite::Database& db() { return database; }
+
+        // The compiled statement for a registered query, prepared on first use and reset (with
+        // its bindings cleared) on every later one.
+        SQLite::Statement& statement(QueryId id);
+
+        void createSchema();
+
+        // Writes all records in one transaction, using multi-row statements for the blob upserts.
+        void saveObjects(std::vector<ObjectRecord>& records);
+
+        // Reads an object's blob and the field rows written since it, for loaders. Returns
+        // false when the object is not stored.
+        bool loadObject(const std::string& module, int64_t id, int64_t& generation, std::string& data,
+                        std::vector<serial::FieldChange>& fields);
+        // Bulk reads for booting a whole module; fields come ordered by object id.
+        void forEachObject(const std::string& module, const std::function<void(int64_t id, int64_t generation, std::string_view data)>& fn);
+        void forEachField(const std::string& module, const std::function<void(int64_t id, serial::FieldChange&& change)>& fn);
+        std::vector<int64_t> objectIds(const std::string& module);
+
+        std::optional<int64_t> objectGeneration(const std::string& module, int64_t id);
+        // 0 when the module has no saved objects.
+        int64_t maxObjectId(const std::string& module);
+
+        // Small key/value facts about the database itself, such as which snapshot matches it.
+        std::optional<std::string> getMeta(const std::string& key);
+        void setMeta(const std::string& key, const std::string& value);
+        void clearMeta(const std::string& key);
+
+        [[nodiscard]] size_t cachedStatements() const;
+
+    private:
+        SQLite::Database database;
+        std::vector<std::unique_ptr<SQLite::Statement>> statements;
+    };
+
+    // Runs wal_checkpoint on its own connection and thread at a fixed interval, so that neither
+    // the game thread nor the persistence writer ever pays for a checkpoint.
+    class Checkpointer {
+    public:
+        ~Checkpointer();
+        void start(const std::string& path, std::chrono::milliseconds interval);
+        // Stops the thread after a final TRUNCATE checkpoint.
+        void stop();
+        // Asks for a checkpoint now instead of at the next interval.
+        void request();
+    private:
+        void run(std::string path, std::chrono::milliseconds interval);
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool running{false};
+        bool requested{false};
+    };
+}
@@ -10,82 +10,211 @@
 #pragma once
 
 #include "net.h"
+#include "commands.h"
+#include "memory.h"
+#include "serialization.h"
+#include "slotmap.h"
+#include "symbols.h"
+#include <boost/container/small_vector.hpp>
+#include <shared_mutex>
+#include <span>
 
 /**********************************************************************
 * Structures                                                          *
 **********************************************************************/
+// Named values grouped in categories, e.g. stats["abilities"]["strength"]. Categories and names
+// are interned, and the entries sit in one flat vector sorted by (category, name), so a lookup
+// is a binary search over integers and all entries of a category are contiguous.
 template<typename T>
 class AttributeManager {
 public:
-    T get(const std::string& category, const std::string& name, const T& defaultValue = T()) {
-        auto cat_it = attributes.find(category);
-        if (cat_it != attributes.end()) {
-            auto& nameMap = cat_it->second;
-            auto name_it = nameMap.find(name);
-            if (name_it != nameMap.end()) {
-                return name_it->second;
-            }
-        }
-        return defaultValue;
+    struct Entry {
+        uint64_t key;
+        T value;
+
+        symbols::Symbol category() const { return static_cast<symbols::Symbol>(key >> 32); }
+        symbols::Symbol name() const { return static_cast<symbols::Symbol>(key); }
+    };
+
+    AttributeManager() = default;
+    // Objects keep their attributes in their module's memory; see memory.h.
+    explicit AttributeManager(std::pmr::memory_resource* resource) : attributes(resource), changes(resource) {}
+
+    T get(const std::string& category, const std::string& name, const T& defaultValue = T()) const {
+        auto value = find(category, name);
+        return value ? *value : defaultValue;
+    }
+    // Lookups without a copy; nullptr when the entry does not exist. The pointer is valid until
+    // the next set() or remove().
+    const T* find(const std::string& category, const std::string& name) const {
+        return find(symbols::find(category), symbols::find(name));
+    }
+    const T* find(symbols::Symbol category, symbols::Symbol name) const {
+        if (category == symbols::none || name == symbols::none) return nullptr;
+        auto it = lowerBound(makeKey(category, name));
+        return it != attributes.end() && it->key == makeKey(category, name) ? &it->value : nullptr;
     }
     void set(const std::string& category, const std::string& name, const T& value) {
-        attributes[category][name] = value;
+        set(symbols::intern(category), symbols::intern(name), value);
+    }
+    void set(symbols::Symbol category, symbols::Symbol name, const T& value) {
+        auto key = makeKey(category, name);
+        assign(key, value);
+        if (tracking && (changes.empty() || changes.back() != key)) changes.push_back(key);
     }
     void remove(const std::string& category, const std::string& name) {
-        auto cat_it = attributes.find(category);
-        if (cat_it != attributes.end()) {
-            cat_it->second.erase(name);
-            if (cat_it->second.empty()) {
-                attributes.erase(category);
-            }
-        }
+        auto c = symbols::find(category), n = symbols::find(name);
+        if (c == symbols::none || n == symbols::none) return;
+        auto key = makeKey(c, n);
+        auto it = lowerBound(key);
+        if (it == attributes.end() || it->key != key) return;
+        attributes.erase(it);
+        if (tracking) changes.push_back(key);
     }
-    bool has(const std::string& category, const std::string& name) {
-        auto cat_it = attributes.find(category);
-        if (cat_it != attributes.end()) {
-            return cat_it->second.find(name) != cat_it->second.end();
-        }
-        return false;
+    bool has(const std::string& category, const std::string& name) const {
+        return find(category, name) != nullptr;
     }
-    std::vector<std::string> listCategories() {
+    std::vector<std::string> listCategories() const {
         std::vector<std::string> categories;
-        for (const auto& pair : attributes) {
-            categories.push_back(pair.first);
+        for (auto it = attributes.begin(); it != attributes.end(); ) {
+            categories.push_back(symbols::name(it->category()));
+            it = lowerBound(makeKey(it->category() + 1, 0));
         }
         return categories;
     }
-    std::vector<std::string> listEntries(const std::string& category) {
-        std::vector<std::string> entries;
-        auto cat_it = attributes.find(category);
-        if (cat_it != attributes.end()) {
-            for (const auto& pair : cat_it->second) {
-                entries.push_back(pair.first);
-            }
+    std::vector<std::string> listEntries(const std::string& category) const {
+        std::vector<std::string> names;
+        for (auto& e : entries(symbols::find(category))) names.push_back(symbols::name(e.name()));
+        return names;
+    }
+
+    // Allocation-free iteration, in (category, name) symbol order.
+    std::span<const Entry> entries() const {
+        return attributes;
+    }
+    std::span<const Entry> entries(symbols::Symbol category) const {
+        if (category == symbols::none) return {};
+        auto first = lowerBound(makeKey(category, 0));
+        auto last = std::find_if(first, attributes.end(), [&](auto& e) { return e.category() != category; });
+        return {first, last};
+    }
+
+    bool empty() const {
+        return attributes.empty();
+    }
+    size_t size() const {
+        return attributes.size();
+    }
+
+    // When tracking is on, set() and remove() remember which entries they touched, for delta saves.
+    // Loading through deserialize() or decode() is never recorded.
+    void trackChanges(bool enabled) {
+        tracking = enabled;
+        if (!enabled) changes.clear();
+    }
+    std::set<std::pair<std::string, std::string>> takeChanges() {
+        std::set<std::pair<std::string, std::string>> out;
+        for (auto key : changes) {
+            out.emplace(symbols::name(static_cast<symbols::Symbol>(key >> 32)), symbols::name(static_cast<symbols::Symbol>(key)));
         }
-        return entries;
+        changes.clear();
+        return out;
+    }
+    bool hasChanges() const {
+        return !changes.empty();
+    }
+
+    // Drops every entry without recording it as a change, and gives their memory back.
+    void clear() {
+        attributes.clear();
+        attributes.shrink_to_fit();
+        changes.clear();
+        changes.shrink_to_fit();
     }
 
-    nlohmann::json serialize() {
+    nlohmann::json serialize() const {
         nlohmann::json j;
-        for (const auto& cat : attributes) {
-            for (const auto& pair : cat.second) {
-                j[cat.first][pair.first] = pair.second;
-            }
+        for (const auto& e : attributes) {
+            j[symbols::name(e.category())][symbols::name(e.name())] = e.value;
         }
         return j;
     }
 
-    void deserialize(nlohmann::json& j) {
+    void deserialize(const nlohmann::json& j) {
         attributes.clear();
         for (auto cat_it = j.begin(); cat_it != j.end(); ++cat_it) {
+            auto category = symbols::intern(cat_it.key());
             for (auto name_it = cat_it->begin(); name_it != cat_it->end(); ++name_it) {
-                attributes[cat_it.key()][name_it.key()] = name_it.value();
+                assign(makeKey(category, symbols::intern(name_it.key())), name_it.value());
+            }
+        }
+    }
+
+    // The binary form, as a body inside a larger blob: categories and names are interned keys.
+    void encode(serial::Writer& w) const {
+        w.varint(categoryCount());
+        for (auto it = attributes.begin(); it != attributes.end(); ) {
+            auto category = it->category();
+            auto last = lowerBound(makeKey(category + 1, 0));
+            w.key(symbols::name(category));
+            w.varint(last - it);
+            for (; it != last; ++it) {
+                w.key(symbols::name(it->name()));
+                serial::writeValue(w, it->value);
             }
         }
     }
 
+    void decode(serial::Reader& r) {
+        attributes.clear();
+        auto categories = r.varint();
+        for (uint64_t i = 0; i < categories; i++) {
+            auto category = symbols::intern(r.key());
+            auto count = r.varint();
+            for (uint64_t n = 0; n < count; n++) {
+                auto name = symbols::intern(r.key());
+                attributes.push_back(Entry{makeKey(category, name), serial::readValue<T>(r)});
+            }
+        }
+        // Appended in the blob's order; sorted once at the end. A repeated key keeps its last value.
+        std::stable_sort(attributes.begin(), attributes.end(), [](auto& a, auto& b) { return a.key < b.key; });
+        auto last = std::unique(attributes.rbegin(), attributes.rend(), [](auto& a, auto& b) { return a.key == b.key; });
+        attributes.erase(attributes.begin(), last.base());
+    }
+
+    std::string serializeBinary() const {
+        serial::Writer w;
+        encode(w);
+        return w.finish(serial::Kind::Attributes, 1);
+    }
+
+    void deserializeBinary(std::string_view blob) {
+        serial::Reader r(blob, serial::Kind::Attributes);
+        decode(r);
+    }
+
 private:
-    std::unordered_map<std::string, std::unordered_map<std::string, T>> attributes;
+    static uint64_t makeKey(symbols::Symbol category, symbols::Symbol name) {
+        return (static_cast<uint64_t>(category) << 32) | name;
+    }
+    typename std::pmr::vector<Entry>::const_iterator lowerBound(uint64_t key) const {
+        return std::lower_bound(attributes.begin(), attributes.end(), key, [](auto& e, uint64_t k) { return e.key < k; });
+    }
+    void assign(uint64_t key, const T& value) {
+        auto it = attributes.begin() + (lowerBound(key) - attributes.cbegin());
+        if (it != attributes.end() && it->key == key) it->value = value;
+        else attributes.insert(it, Entry{key, value});
+    }
+    size_t categoryCount() const {
+        size_t count = 0;
+        for (auto it = attributes.begin(); it != attributes.end(); it = lowerBound(makeKey(it->category() + 1, 0))) count++;
+        return count;
+    }
+
+    std::pmr::vector<Entry> attributes;
+    bool tracking{false};
+    // keys touched since the last takeChanges(); may repeat.
+    std::pmr::vector<uint64_t> changes;
 };
 
 struct CompiledScript {
@@ -95,41 +224,398 @@ struct CompiledScript {
 
 class GameObject;
 
+// Every object of a module, densely packed, with its id.
+using ObjectSlots = SlotMap<std::pair<int64_t, std::shared_ptr<GameObject>>>;
+
+// A non-owning reference to a GameObject that is as cheap to copy as an integer. Resolving it
+// through its module is O(1) and touches no reference count. It resolves to nothing once the
+// object is removed, or when the slot holds an object of another generation.
+struct ObjectHandle {
+    ObjectSlots::Handle slot;
+    int64_t generation{0};
+
+    explicit operator bool() const { return bool(slot); }
+    bool operator==(const ObjectHandle&) const = default;
+};
+
+// Any object of any module: the module and the object's handle in it. Resolves to nothing once
+// the object is gone.
+struct ObjectLink {
+    GameModule* module{nullptr};
+    ObjectHandle handle;
+
+    GameObject* resolve() const;
+};
+
+// A process-wide id for each component type, handed out on first use.
+uint32_t nextComponentId();
+template<typename T>
+uint32_t componentId() {
+    static const uint32_t id = nextComponentId();
+    return id;
+}
+
+// Hot per-object data kept column-wise, outside the GameObject nodes. A pool holds one component
+// type for the objects of one module in a dense array, and a sparse set maps object slots to
+// positions in it, so a system that sweeps a component reads contiguous memory no matter where
+// the objects themselves live. Removal moves the last element into the hole; iteration order is
+// unspecified. Components are runtime state and are not saved.
+class ComponentPoolBase {
+public:
+    virtual ~ComponentPoolBase() = default;
+    virtual bool remove(const ObjectHandle& handle) = 0;
+    [[nodiscard]] bool contains(const ObjectHandle& handle) const {
+        auto position = find(handle.slot.index);
+        return position != absent && m_handles[position] == handle;
+    }
+    [[nodiscard]] size_t size() const { return m_handles.size(); }
+    // Parallel to the component values.
+    std::span<const ObjectHandle> handles() const { return m_handles; }
+
+protected:
+    static constexpr uint32_t absent = UINT32_MAX;
+    uint32_t find(uint32_t slot) const { return slot < m_sparse.size() ? m_sparse[slot] : absent; }
+    // object slot -> position in the dense arrays.
+    std::vector<uint32_t> m_sparse;
+    std::vector<ObjectHandle> m_handles;
+
+    template<typename... Ts> friend class ComponentView;
+};
+
+template<typename T>
+class ComponentPool : public ComponentPoolBase {
+public:
+    // Replaces the component if the object already has one.
+    template<typename... Args>
+    T& emplace(const ObjectHandle& handle, Args&&... args) {
+        auto slot = handle.slot.index;
+        if(auto position = find(slot); position != absent) {
+            m_handles[position] = handle;
+            return m_values[position] = T(std::forward<Args>(args)...);
+        }
+        if(slot >= m_sparse.size()) m_sparse.resize(slot + 1, absent);
+        m_sparse[slot] = static_cast<uint32_t>(m_values.size());
+        m_handles.push_back(handle);
+        return m_values.emplace_back(std::forward<Args>(args)...);
+    }
+
+    T* get(const ObjectHandle& handle) {
+        return contains(handle) ? &m_values[m_sparse[handle.slot.index]] : nullptr;
+    }
+
+    bool remove(const ObjectHandle& handle) override {
+        if(!contains(handle)) return false;
+        auto hole = m_sparse[handle.slot.index];
+        if(hole != m_values.size() - 1) {
+            m_values[hole] = std::move(m_values.back());
+            m_handles[hole] = m_handles.back();
+            m_sparse[m_handles[hole].slot.index] = hole;
+        }
+        m_values.pop_back();
+        m_handles.pop_back();
+        m_sparse[handle.slot.index] = absent;
+        return true;
+    }
+
+    void reserve(size_t count) {
+        m_values.reserve(count);
+        m_handles.reserve(count);
+    }
+
+    std::span<T> values() { return m_values; }
+
+private:
+    std::vector<T> m_values;
+
+    template<typename... Ts> friend class ComponentView;
+};
+
+// The objects of a module that have every one of Ts. each() walks the smallest of the pools and
+// looks the others up by slot; with a single component it is a plain linear scan. The callback
+// takes the components, optionally preceded by the object's handle. It must not add or remove
+// components of the types being iterated.
+template<typename... Ts>
+class ComponentView {
+public:
+    explicit ComponentView(ComponentPool<Ts>&... pools) : pools(&pools...) {}
+
+    template<typename F>
+    void each(F&& fn) {
+        const ComponentPoolBase* smallest = std::get<0>(pools);
+        std::apply([&](auto*... p) { ((smallest = p->size() < smallest->size() ? p : smallest), ...); }, pools);
+        auto& handles = smallest->m_handles;
+        for(size_t i = 0; i < handles.size(); i++) {
+            auto slot = handles[i].slot.index;
+            std::array<uint32_t, sizeof...(Ts)> positions;
+            bool all = true;
+            size_t k = 0;
+            std::apply([&](auto*... p) { ((positions[k++] = p == smallest ? static_cast<uint32_t>(i) : p->find(slot)), ...); }, pools);
+            for(auto position : positions) all &= position != ComponentPoolBase::absent;
+            if(!all) continue;
+            call(fn, handles[i], positions, std::index_sequence_for<Ts...>{});
+        }
+    }
+
+private:
+    template<typename F, size_t... I>
+    void call(F& fn, const ObjectHandle& handle, const std::array<uint32_t, sizeof...(Ts)>& positions, std::index_sequence<I...>) {
+        if constexpr(std::is_invocable_v<F&, const ObjectHandle&, Ts&...>) {
+            fn(handle, std::get<I>(pools)->m_values[positions[I]]...);
+        } else {
+            fn(std::get<I>(pools)->m_values[positions[I]]...);
+        }
+    }
+
+    std::tuple<ComponentPool<Ts>*...> pools;
+};
+
+template<typename T>
+class ComponentView<T> {
+public:
+    explicit ComponentView(ComponentPool<T>& pool) : pool(&pool) {}
+
+    template<typename F>
+    void each(F&& fn) {
+        auto& values = pool->m_values;
+        if constexpr(std::is_invocable_v<F&, const ObjectHandle&, T&>) {
+            auto& handles = pool->m_handles;
+            for(size_t i = 0; i < values.size(); i++) fn(handles[i], values[i]);
+        } else {
+            for(auto& value : values) fn(value);
+        }
+    }
+
+private:
+    ComponentPool<T>* pool;
+};
+
+enum class ObjectField : uint32_t;
+namespace readview {
+    struct ObjectView;
+}
+namespace query {
+    enum class IndexKind : uint8_t;
+    struct Attribute;
+    class Index;
+}
+
 class GameModule {
     friend class GameObject;
 public:
     GameModule(std::filesystem::path folder);
+    ~GameModule();
     const std::string& getName() const;
-    std::weak_ptr<GameObject> getGameObject(int64_t id, int64_t generation = -1) const;
+    // Where the module's objects and their contents are allocated; see memory.h.
+    memory::ModuleResource& getMemory() const;
+    // In a paged module this also finds saved objects that are not in memory yet; they come
+    // back as shells whose contents load on first use.
+    std::weak_ptr<GameObject> getGameObject(int64_t id, int64_t generation = -1);
     std::weak_ptr<GameObject> createGameObject(int64_t id = -1, int64_t generation = -1);
-    const std::map<int64_t, std::shared_ptr<GameObject>>& getGameObjects() const;
+    // Adds a saved object without loading it; its contents load on first use.
+    std::shared_ptr<GameObject> createShell(int64_t id, int64_t generation);
+    // Drops the object from the module; persistence deletes its saved state.
+    bool removeGameObject(int64_t id);
+    const ObjectSlots& getGameObjects() const;
+
+    // Handles are the fast path for code that holds on to objects. The weak_ptr API above keeps
+    // working alongside them, and getGameObject(handle) bridges the two.
+    ObjectHandle getHandle(int64_t id, int64_t generation = -1);
+    GameObject* resolve(const ObjectHandle& handle) const;
+    std::weak_ptr<GameObject> getGameObject(const ObjectHandle& handle) const;
     void saveAll();
+    // Hands over the ids marked dirty since the last call.
+    std::set<int64_t> takeDirty();
+    // The same for readview::publish(), which also hears about objects that were loaded. Only
+    // collected while read views are enabled; ids may repeat.
+    std::vector<int64_t> takeViewChanges();
+    // The object with this id if it is in memory, resident or not. Never creates a shell.
+    GameObject* findInMemory(int64_t id) const;
+    bool isDirty(int64_t id);
+
+    // See residency.h.
+    void setPaged(bool paged);
+    bool isPaged() const;
+
+    // Opt-in component storage (see ComponentPool). A pool is created the first time its type
+    // is used; an object's components go away with the object.
+    template<typename T>
+    ComponentPool<T>& components() {
+        auto id = componentId<T>();
+        if(id >= m_components.size()) m_components.resize(id + 1);
+        if(!m_components[id]) m_components[id] = std::make_unique<ComponentPool<T>>();
+        return static_cast<ComponentPool<T>&>(*m_components[id]);
+    }
+    template<typename... Ts>
+    ComponentView<Ts...> view() {
+        return ComponentView<Ts...>(components<Ts>()...);
+    }
+
+    // Secondary indexes over attributes (see query.h). Creating one indexes the loaded objects
+    // right away; creating it again returns the existing index. findIndex() with ordered set only
+    // returns an index that can answer ranges.
+    query::Index& createIndex(const query::Attribute& attribute, query::IndexKind kind);
+    const query::Index* findIndex(const query::Attribute& attribute, bool ordered = false) const;
+    bool dropIndex(const query::Attribute& attribute, query::IndexKind kind);
 protected:
     void markDirty(int64_t id);
+    void clearDirty(int64_t id);
 private:
     std::string name;
-    std::map<int64_t, std::shared_ptr<GameObject>> m_gameObjects;
+    GameObject* find(int64_t id, int64_t generation);
+    void insert(const std::shared_ptr<GameObject>& obj);
+    void insertLocked(const std::shared_ptr<GameObject>& obj);
+    std::shared_lock<std::shared_mutex> readObjects() const;
+    // Unlinks every relation to and from an object that is leaving the module.
+    void detach(GameObject& obj);
+
+    // The reverse relations of this module's objects, indexed by slot: for each relation name,
+    // the objects pointing here. Every edge's position is remembered by its source, so linking
+    // and unlinking are O(1).
+    struct ReverseEdge {
+        GameModule* module;
+        ObjectHandle source;
+    };
+    struct ReverseEntry {
+        symbols::Symbol name;
+        std::vector<ReverseEdge> sources;
+    };
+    uint32_t linkReverse(uint32_t slot, symbols::Symbol name, ReverseEdge edge);
+    void unlinkReverse(uint32_t slot, symbols::Symbol name, uint32_t position);
+    const std::vector<ReverseEdge>* reverseEdges(uint32_t slot, symbols::Symbol name) const;
+    std::vector<std::vector<ReverseEntry>> m_reverse;
+
+    // shared with every object allocated from it, so it outlives the module if they do.
+    std::shared_ptr<memory::ModuleResource> m_memory;
+    // Guards m_gameObjects and m_slotsById. A paged module adds shells whenever something
+    // refers to a saved object that is not loaded, which can happen from any input partition, so
+    // its lookups take the lock too; other modules only change on the game strand and read
+    // without it.
+    mutable std::shared_mutex m_objectsMutex;
+    ObjectSlots m_gameObjects;
+    // indexed by componentId().
+    std::vector<std::unique_ptr<ComponentPoolBase>> m_components;
+    std::vector<std::unique_ptr<query::Index>> m_indexes;
+    std::unordered_map<int64_t, ObjectSlots::Handle> m_slotsById;
+    // ids are never reused within a run, even after a removal.
+    int64_t m_maxId{0};
+    bool m_paged{false};
+    // the highest id in the database, looked up once when a paged module first creates an object.
+    std::optional<int64_t> m_savedMaxId;
+    // objects of one module can be touched from several input partitions at once.
+    std::mutex dirtyMutex;
     std::set<int64_t> dirtyObjects;
+    std::vector<int64_t> viewChanges;
     std::filesystem::path folder;
 };
 
+// Every loaded GameModule, by name. Object references in saved data are resolved through this.
+extern std::map<std::string, std::shared_ptr<GameModule>> gameModules;
+
 class EventHandler {
 public:
 
 };
 
-class GameObject {
+// The fields of a saved GameObject. These are the field tags of its binary blob and the field
+// column of its delta rows, so retired values must never be reused.
+enum class ObjectField : uint32_t {
+    Parent = 1,
+    Owner = 2,
+    Relations = 3,
+    Stats = 4,
+    Strings = 5
+};
+
+class GameObject : public std::enable_shared_from_this<GameObject> {
+    friend class GameModule;
 public:
     GameObject(GameModule *module, int64_t id, int64_t generation);
+    ~GameObject();
     std::string renderID() const;
+    int64_t getID() const;
+    int64_t getGeneration() const;
+    // Resolved through getModule(); see ObjectHandle.
+    ObjectHandle getHandle() const;
 
     nlohmann::json serialize();
     void deserialize(const nlohmann::json& j);
 
+    // The compact binary form used for saves. References are resolved through gameModules,
+    // just like deserialize() does.
+    std::string serializeBinary() const;
+    void deserializeBinary(std::string_view blob);
+    // Decodes a binary blob into the same JSON serialize() produces, for debugging and migration.
+    static nlohmann::json exportJson(std::string_view blob);
+
+    // Boot. The first pass loads everything but references and may run concurrently for objects
+    // of different modules; resolveReferences() links them once every module exists. Objects
+    // loaded from the database are clean afterwards, objects loaded from JSON get saved.
+    void loadDeferred(std::string_view blob, const std::vector<serial::FieldChange>& fields);
+    void loadDeferred(const nlohmann::json& j);
+    void resolveReferences();
+
+    // Delta saves. Until the next full save, every change is reported per field entry: the
+    // parent, the owner, one relation, or one attribute.
+    bool needsFullSave() const;
+    void requestFullSave();
+    std::vector<serial::FieldChange> takeChanges();
+    void clearChanges();
+    // Applies a delta row on top of what deserializeBinary() loaded. Like the setters, this
+    // records a change; loaders call clearChanges() when they are done.
+    void applyChange(const serial::FieldChange& change);
+    bool hasChanges() const;
+
+    // Paged residency. An evicted object keeps its identity and its reverse relations; all
+    // other contents are dropped and reloaded the next time anything touches them.
+    bool isResident() const;
+    // Loads the object now if it is a shell.
+    void ensureResident() const;
+    uint64_t lastTouched() const;
+    // Fails (returning false) while the object has changes that were not handed to persistence.
+    bool evict();
+    // Loads a saved blob and its delta rows into a shell. Changes made while the object was
+    // out, such as a removed container letting go of it, are kept.
+    void restore(std::string_view blob, const std::vector<serial::FieldChange>& fields);
+    // Tells residency accounting how large the object's saved form is.
+    void noteEncodedSize(size_t bytes);
+
+    // An immutable copy for readview::publish(). Does not load the object.
+    std::shared_ptr<const readview::ObjectView> capture() const;
+
+    double getStat(const std::string& category, const std::string& name, double defaultValue = 0.0) const;
+    void setStat(const std::string& category, const std::string& name, double value);
+    std::string getString(const std::string& category, const std::string& name, const std::string& defaultValue = "") const;
+    void setString(const std::string& category, const std::string& name, const std::string& value);
+    // Lookups by symbol without a copy; nullptr when the entry does not exist. Unlike getStat(),
+    // these neither load nor touch the object.
+    const double* findStat(symbols::Symbol category, symbols::Symbol name) const;
+    const std::string* findString(symbols::Symbol category, symbols::Symbol name) const;
+
+    // Components live in the module's pools, not in the object; these are shortcuts to them.
+    template<typename T, typename... Args>
+    T& addComponent(Args&&... args) {
+        return m_module->components<T>().emplace(m_handle, std::forward<Args>(args)...);
+    }
+    template<typename T>
+    T* getComponent() const {
+        return m_module->components<T>().get(m_handle);
+    }
+    template<typename T>
+    bool removeComponent() {
+        return m_module->components<T>().remove(m_handle);
+    }
+
+    // The symbol overloads skip interning the name; see symbols.h.
     std::shared_ptr<GameObject> getRelation(const std::string& name) const;
+    std::shared_ptr<GameObject> getRelation(symbols::Symbol name) const;
     void setRelation(const std::string& name, std::shared_ptr<GameObject> parent);
+    void setRelation(symbols::Symbol name, std::shared_ptr<GameObject> target);
+    // Where a relation points, without loading or counting a reference to either object. The
+    // handle may be stale if the target was removed.
+    ObjectLink relationLink(symbols::Symbol name) const;
 
     std::set<std::shared_ptr<GameObject>> getReverseRelation(const std::string& name) const;
+    std::set<std::shared_ptr<GameObject>> getReverseRelation(symbols::Symbol name) const;
 
     GameModule* getModule() const;
 
@@ -137,17 +623,99 @@ public:
     void setOwner(std::shared_ptr<GameObject> owner);
 
     std::shared_ptr<GameObject> getParent() const;
+    // The same, without loading or counting a reference to either object.
+    ObjectLink parentLink() const;
+    // Refuses (with a warning) to put an object inside itself or its own contents.
     void setParent(std::shared_ptr<GameObject> parent);
 
+    // Containment. Every object indexes what it contains and what it owns, so room, inventory and
+    // container queries never scan a module. Only loaded objects are indexed: in a paged module,
+    // contents that were never loaded are not listed.
+    std::vector<std::shared_ptr<GameObject>> getContents() const;
+    std::vector<std::shared_ptr<GameObject>> getPossessions() const;
+    size_t contentsCount() const;
+    // Everything inside this object, recursively. Kept up to date on every move, so O(1).
+    size_t subtreeCount() const;
+
+    // Depth-first (pre-order) over everything inside an object, recursively. Never touches a
+    // reference count; the contents must not be moved while iterating.
+    class Descendants {
+    public:
+        class iterator {
+        public:
+            using value_type = GameObject;
+            using difference_type = std::ptrdiff_t;
+            GameObject& operator*() const { return *current; }
+            GameObject* operator->() const { return current; }
+            iterator& operator++() { advance(); return *this; }
+            bool operator==(const iterator& other) const { return current == other.current; }
+        private:
+            friend class Descendants;
+            void advance();
+            GameObject* current{nullptr};
+            // each level being walked, with the index of the next of its contents.
+            boost::container::small_vector<std::pair<const GameObject*, uint32_t>, 8> stack;
+        };
+        explicit Descendants(const GameObject* root) : root(root) {}
+        iterator begin() const;
+        iterator end() const { return {}; }
+    private:
+        const GameObject* root;
+    };
+    Descendants descendants() const;
+
 private:
     GameModule* m_module;
     int64_t m_id, m_generation;
+    ObjectHandle m_handle;
+
+    ObjectLink m_parent, m_owner;
+    // The index side of setParent()/setOwner(): what this object contains and owns, and where
+    // it sits in its own parent's and owner's lists.
+    std::pmr::vector<ObjectLink> m_contents, m_possessions;
+    uint32_t m_parentSlot{0}, m_ownerSlot{0};
+    uint32_t m_subtreeCount{0};
+    void linkParent(GameObject* parent);
+    void linkOwner(GameObject* owner);
+
+    // Our outgoing relations. The other direction lives in the target module's reverse index,
+    // at reverseSlot of the target's edges for this name.
+    struct Relation {
+        symbols::Symbol name;
+        uint32_t reverseSlot;
+        GameModule* module;
+        ObjectHandle target;
+    };
+    boost::container::small_vector<Relation, 2> m_relations;
+    Relation* findRelation(symbols::Symbol name);
+    const Relation* findRelation(symbols::Symbol name) const;
+    GameObject* relationTarget(const Relation& r) const;
+
+    AttributeManager<double> m_stats;
+    AttributeManager<std::string> m_strings;
+    // Keeps the module's attribute indexes in step with one entry, or with every entry after a
+    // load replaced them all.
+    void reindex(ObjectField field, symbols::Symbol category, symbols::Symbol name);
+    void reindexAll();
+
+    void touch() const;
+    void reload();
+
+    struct PendingReferences;
+    std::unique_ptr<PendingReferences> m_pending;
 
-    std::weak_ptr<GameObject> m_parent;
-    std::weak_ptr<GameObject> m_owner;
+    bool m_resident{true};
+    // false for a shell whose parent, owner and relations were never loaded; eviction keeps them.
+    bool m_linksLoaded{true};
+    mutable std::atomic<uint64_t> m_lastTouched{0};
+    int64_t m_residentBytes{0};
 
-    std::unordered_map<std::string, std::weak_ptr<GameObject>> m_relations;
-    std::unordered_map<std::string, std::set<std::weak_ptr<GameObject>>> m_reverseRelations;
+    // new objects have never been saved, so their first save is a full one.
+    bool m_fullSave{true};
+    // delta saves since the last full one; their rows pile up until a full save folds them in.
+    uint32_t m_deltaSaves{0};
+    bool m_parentChanged{false}, m_ownerChanged{false};
+    boost::container::small_vector<symbols::Symbol, 2> m_changedRelations;
 
 };
 
@@ -167,7 +735,9 @@ protected:
 
 class PlayView {
 public:
+    // Observes the character for interest management (see interest.h) until destroyed.
     PlayView(std::shared_ptr<GameObject> character);
+    ~PlayView();
     void onConnectionLost(int64_t);
     void onConnectionClosed(int64_t);
 
@@ -178,6 +748,10 @@ public:
     void addParser(std::shared_ptr<PlayViewParser> parser);
     void update(double deltaTime);
     bool isActive();
+    // The module the character is standing in, and the character's own module. A parallel input
+    // partition owns both (see processInputParallel()).
+    GameModule* getZone();
+    GameModule* getCharacterModule();
 private:
     std::weak_ptr<GameObject> character;
     std::weak_ptr<GameObject> puppet;
@@ -193,5 +767,6 @@ private:
     std::list<std::string> input_queue;
     std::string output;        /* ptr to the current output buffer	*/
     std::list<std::string> history;        /* History of commands, for ! mostly.	*/
+    commands::AliasTable aliases;        /* the player's aliases, resolved before commands */
 
 };
@@ -0,0 +1,20 @@
+#pragma once
+#include "sysdep.h"
+
+// Interned names. Strings that keep coming back as keys (relation names, attribute categories)
+// are stored once and referred to by a small integer, so comparing or hashing one is an integer
+// operation. Symbols are never freed and are only meaningful within one run; anything saved
+// stores the name.
+namespace symbols {
+    using Symbol = uint32_t;
+    constexpr Symbol none = UINT32_MAX;
+
+    // Thread-safe. Returns the existing symbol if the name was interned before.
+    Symbol intern(std::string_view name);
+    // The symbol of a name that was interned before, or none. Never adds anything, so lookups
+    // of names nobody uses do not grow the table.
+    Symbol find(std::string_view name);
+    // The reference stays valid for the rest of the run.
+    const std::string& name(Symbol symbol);
+    size_t count();
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "sysdep.h"
+
+namespace watchdog {
+    // Starts a thread which watches the tick profiler's Marker. When a single tick runs longer
+    // than config::watchdogThreshold it logs the stuck phase and system, a backtrace of the
+    // game thread, and the Lua stack if a script::Task is running.
+    void start();
+    void stop();
+}
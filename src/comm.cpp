@@ -18,6 +18,13 @@
 #include <locale>
 
 #include "kai/db.h"
+#include "kai/profiler.h"
+#include "kai/watchdog.h"
+#include "kai/replay.h"
+#include "kai/persistence.h"
+#include "kai/residency.h"
+#include "kai/snapshot.h"
+#include "kai/readview.h"
 
 /* local globals */
 std::map<int64_t, std::shared_ptr<PlayView>> playviews;
@@ -28,10 +35,13 @@ int circle_shutdown, circle_reboot;
 ***********************************************************************/
 
 void broadcast(const std::string& txt) {
-    logger->info("Broadcasting: {}", txt.c_str());
-    for(auto &[cid, c] : net::connections) {
-        c->sendText(txt);
-    }
+    // every connection, so not something an input partition may do by itself.
+    defer_action([txt] {
+        logger->info("Broadcasting: {}", txt.c_str());
+        for(auto &[cid, c] : net::connections) {
+            c->sendText(txt);
+        }
+    });
 }
 
 boost::asio::awaitable<void> signal_watcher() {
@@ -69,14 +79,26 @@ boost::asio::awaitable<void> yield_for(std::chrono::milliseconds ms) {
 }
 
 
-static std::vector<std::pair<std::string, double>> timings;
+static const auto phaseConnections = profiler::registerPhase("process connections");
+static const auto phaseLogins = profiler::registerPhase("handle logins");
+static const auto phaseInput = profiler::registerPhase("handle input");
+static const auto phaseHeartbeat = profiler::registerPhase("heartbeat total");
+static const auto phaseOutput = profiler::registerPhase("process output");
+static const auto phasePrompts = profiler::registerPhase("print prompts");
+static const auto phaseCloseSockets = profiler::registerPhase("close sockets");
+static const auto phaseDirty = profiler::registerPhase("process_dirty");
+static const auto phaseEvict = profiler::registerPhase("residency.evict");
+static const auto phaseMaterialize = profiler::registerPhase("snapshot.materialize");
+static const auto phasePublish = profiler::registerPhase("readview.publish");
 
 struct GameSystem {
     // In seconds.
     GameSystem(std::string name, double interval, std::function<void(double)> func) : name(std::move(name)), interval(interval), func(std::move(func)) {
         countdown = interval;
+        phase = profiler::registerPhase(this->name, profiler::PhaseKind::System);
     }
     std::string name;
+    profiler::PhaseId phase{profiler::invalidPhase};
     double interval{0.0};
     std::function<void(double)> func;
     double countdown{0.0};
@@ -90,12 +112,11 @@ static std::vector<GameSystem> gameSystems = {
 
 boost::asio::awaitable<void> heartbeat(double deltaTime) {
     static int mins_since_crashsave = 0;
-    timings.clear();
 
     for(auto &s : gameSystems) {
         s.countdown -= deltaTime;
         if(s.countdown <= 0.0) {
-            auto start = std::chrono::high_resolution_clock::now();
+            profiler::Scope scope(s.phase);
             try {
                 s.func(deltaTime);
             }
@@ -107,8 +128,6 @@ boost::asio::awaitable<void> heartbeat(double deltaTime) {
                 logger->info("Unknown exception while running GameService '{}'", s.name.c_str());
                 shutdown_game(1);
             }
-            auto end = std::chrono::high_resolution_clock::now();
-            timings.emplace_back(s.name, std::chrono::duration<double>(end - start).count());
             s.countdown += s.interval;
         }
     }
@@ -146,10 +165,104 @@ void processConnections(double deltaTime) {
     }
 }
 
+/*
+ * Opt-in parallel input processing (config::parallelInput). A partition owns a set of modules:
+ * the zone (GameModule) each of its views' characters is in and the module of the character
+ * itself. Views that share any of those modules share a partition, and each partition's input
+ * runs on its own strand across the thread pool. Modules are not locked, so creating, changing,
+ * linking or removing objects of any module the partition does not own must go through
+ * defer_action(), which queues it for the game strand once every partition has finished. With
+ * every character in one module, everything ends up in one partition.
+ */
+struct InputPartition {
+    explicit InputPartition(boost::asio::strand<boost::asio::io_context::executor_type> strand) : strand(std::move(strand)) {}
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand;
+    std::vector<PlayView*> views;
+    std::vector<std::function<void()>> deferred;
+    std::exception_ptr error;
+};
+
+static std::map<GameModule*, InputPartition> inputPartitions;
+static thread_local InputPartition *currentPartition = nullptr;
+
+void defer_action(std::function<void()> action) {
+    if(currentPartition) currentPartition->deferred.push_back(std::move(action));
+    else action();
+}
+
+static boost::asio::awaitable<void> processInputParallel(double deltaTime) {
+    // Union-find over modules: a view joins its zone and its character's module together, and
+    // each resulting set is one partition, keyed by its root.
+    std::unordered_map<GameModule*, GameModule*> joined;
+    auto root = [&](GameModule* m) {
+        while(true) {
+            auto it = joined.try_emplace(m, m).first;
+            if(it->second == m) return m;
+            it->second = joined[it->second];
+            m = it->second;
+        }
+    };
+    for(auto &[id, p] : playviews) {
+        auto a = root(p->getZone()), b = root(p->getCharacterModule());
+        if(a != b) joined[b] = a;
+    }
+
+    for(auto &[zone, part] : inputPartitions) part.views.clear();
+    for(auto &[id, p] : playviews) {
+        auto zone = root(p->getZone());
+        auto it = inputPartitions.find(zone);
+        if(it == inputPartitions.end()) {
+            it = inputPartitions.try_emplace(zone, boost::asio::make_strand(*net::io)).first;
+        }
+        it->second.views.push_back(p.get());
+    }
+    std::erase_if(inputPartitions, [](const auto &kv) { return kv.second.views.empty(); });
+
+    net::Channel<int> done(*net::io, inputPartitions.size());
+    for(auto &[zone, part] : inputPartitions) {
+        boost::asio::post(part.strand, [&part, &done, deltaTime]() {
+            currentPartition = &part;
+            try {
+                for(auto v : part.views) v->update(deltaTime);
+            } catch(...) {
+                part.error = std::current_exception();
+            }
+            currentPartition = nullptr;
+            done.try_send(boost::system::error_code{}, 0);
+        });
+    }
+    for(size_t i = 0; i < inputPartitions.size(); i++) {
+        co_await done.async_receive(boost::asio::use_awaitable);
+    }
+
+    // Deferred actions belong to this tick, so they run even if a partition failed; the first
+    // error is rethrown once every queue is drained.
+    std::exception_ptr error;
+    for(auto &[zone, part] : inputPartitions) {
+        if(part.error && !error) error = part.error;
+        part.error = nullptr;
+    }
+    for(auto &[zone, part] : inputPartitions) {
+        auto actions = std::exchange(part.deferred, {});
+        for(auto &action : actions) {
+            try {
+                action();
+            } catch(...) {
+                if(!error) error = std::current_exception();
+            }
+        }
+    }
+    if(error) std::rethrow_exception(error);
+}
+
 boost::asio::awaitable<void> runOneLoop(double deltaTime) {
     static bool sleeping = false;
 
-    processConnections(deltaTime);
+    {
+        profiler::Scope scope(phaseConnections);
+        processConnections(deltaTime);
+    }
 
     if(sleeping && !playviews.empty()) {
         logger->info("Waking up.");
@@ -165,25 +278,24 @@ boost::asio::awaitable<void> runOneLoop(double deltaTime) {
     }
 
     {
+        profiler::Scope scope(phaseLogins);
         std::set<struct PlayView*> toLook;
-        auto start = std::chrono::high_resolution_clock::now();
         for(auto p : playviews) {
 
         }
-
-        auto end = std::chrono::high_resolution_clock::now();
-        timings.emplace_back("handle logins", std::chrono::duration<double>(end - start).count());
     }
 
 
     /* Process commands we just read from process_input */
     try {
-        auto start = std::chrono::high_resolution_clock::now();
-        for (auto &[id, p] : playviews) {
-            p->update(deltaTime);
+        profiler::Scope scope(phaseInput);
+        if(config::parallelInput && config::usingMultithreading) {
+            co_await processInputParallel(deltaTime);
+        } else {
+            for (auto &[id, p] : playviews) {
+                p->update(deltaTime);
+            }
         }
-        auto end = std::chrono::high_resolution_clock::now();
-        timings.emplace_back("handle input", std::chrono::duration<double>(end - start).count());
     }
     catch(const std::exception& e) {
         logger->info("Exception while processing input: {}", e.what());
@@ -205,40 +317,32 @@ boost::asio::awaitable<void> runOneLoop(double deltaTime) {
     }
 
     if(gameActive) {
-        auto start = std::chrono::high_resolution_clock::now();
+        profiler::Scope scope(phaseHeartbeat);
         co_await heartbeat(deltaTime);
-        auto end = std::chrono::high_resolution_clock::now();
-        timings.emplace_back("heartbeat total", std::chrono::duration<double>(end - start).count());
     }
 
     /* Send queued output out to the operating system (ultimately to user). */
     {
-        auto start = std::chrono::high_resolution_clock::now();
+        profiler::Scope scope(phaseOutput);
         for (auto &[pid, p] : playviews) {
 
         }
-        auto end = std::chrono::high_resolution_clock::now();
-        timings.emplace_back("process output", std::chrono::duration<double>(end - start).count());
     }
 
     /* Print prompts for other descriptors who had no other output */
     {
-        auto start = std::chrono::high_resolution_clock::now();
+        profiler::Scope scope(phasePrompts);
         for (auto &[pid, p] : playviews) {
 
         }
-        auto end = std::chrono::high_resolution_clock::now();
-        timings.emplace_back("print prompts", std::chrono::duration<double>(end - start).count());
     }
 
     /* Kick out folks in the CON_CLOSE or CON_DISCONNECT state */
     {
-        auto start = std::chrono::high_resolution_clock::now();
+        profiler::Scope scope(phaseCloseSockets);
         for (auto &[pid, p] : playviews) {
 
         }
-        auto end = std::chrono::high_resolution_clock::now();
-        timings.emplace_back("close sockets", std::chrono::duration<double>(end - start).count());
     }
 }
 
@@ -256,30 +360,43 @@ boost::asio::awaitable<void> game_loop() {
     double saveTimer = 60.0 * 5.0;
     double deltaTimeInSeconds = 0.1;
     gameIsLoading = false;
+    profiler::openTrace(config::profilerTraceFile);
+    try {
+        persistence::start();
+    } catch (std::exception &e) {
+        logger->critical("Could not start persistence: {}", e.what());
+        shutdown_game(1);
+    }
+    if(config::readViews) readview::enable();
 
     /* The Main Loop.  The Big Cheese.  The Top Dog.  The Head Honcho.  The.. */
     while (!circle_shutdown) {
 
         auto loopStart = boost::asio::steady_timer::clock_type::now();
+        profiler::beginTick();
         try {
-            SQLite::Transaction transaction(*assetDb);
             co_await runOneLoop(deltaTimeInSeconds);
             if(circle_shutdown) saveAll = true;
             if(saveAll) {
-                //dirty_all();
+                for(auto &[name, module] : gameModules) module->saveAll();
             }
             {
-                auto start = boost::asio::steady_timer::clock_type::now();
-                //process_dirty();
-                auto end = boost::asio::steady_timer::clock_type::now();
-                timings.emplace_back("process_dirty", std::chrono::duration<double>(end - start).count());
+                // Only snapshots are taken here; the persistence thread does the SQLite work.
+                profiler::Scope scope(phaseDirty);
+                persistence::processDirty();
+            }
+            if(readview::enabled()) {
+                // Before eviction, so everything that changed this tick is still loaded.
+                profiler::Scope scope(phasePublish);
+                readview::publish();
             }
-
             {
-                auto start = boost::asio::steady_timer::clock_type::now();
-                transaction.commit();
-                auto end = boost::asio::steady_timer::clock_type::now();
-                timings.emplace_back("transaction.commit", std::chrono::duration<double>(end - start).count());
+                profiler::Scope scope(phaseEvict);
+                residency::evict();
+            }
+            if(snapshot::isOpen()) {
+                profiler::Scope scope(phaseMaterialize);
+                snapshot::materialize(config::snapshotMaterializePerTick);
             }
 
             saveTimer -= deltaTimeInSeconds;
@@ -287,7 +404,7 @@ boost::asio::awaitable<void> game_loop() {
                 saveTimer = 60.0 * 5.0;
                 //dump_state();
             }
-            //if(saveAll) saveAll = false;
+            if(saveAll) saveAll = false;
 
         } catch(std::exception& e) {
             logger->info("Exception in runOneLoop(): {}", e.what());
@@ -296,6 +413,7 @@ boost::asio::awaitable<void> game_loop() {
              logger->info("Unknown exception in runOneLoop()");
             shutdown_game(1);
         }
+        profiler::endTick();
         auto loopEnd = boost::asio::steady_timer::clock_type::now();
 
         auto loopDuration = loopEnd - loopStart;
@@ -305,11 +423,8 @@ boost::asio::awaitable<void> game_loop() {
         if(nextWait.count() < 0) {
             if(config::logEgregiousTimings) {
                 logger->warn("Heartbeat took {} too long, defaulting to short wait", abs(std::chrono::duration<double>(nextWait).count()));
-                for(auto &t : timings) {
-                    logger->warn("Timing {}: {}", t.first, std::chrono::duration<double>(t.second).count());
-                }
+                profiler::logLastTick();
             }
-            timings.clear();
             nextWait = std::chrono::milliseconds(1);
         }
 
@@ -318,6 +433,14 @@ boost::asio::awaitable<void> game_loop() {
         deltaTimeInSeconds = std::chrono::duration<double>(boost::asio::steady_timer::clock_type::now() - loopStart).count();
     }
 
+    // The shutdown barrier: everything handed off above is on disk before we go.
+    persistence::stop();
+    readview::shutdown();
+    // The database is final now, so the next boot can map the world instead of loading it.
+    if(circle_reboot) snapshot::write(config::snapshotFile);
+    snapshot::close();
+    residency::close();
+    profiler::closeTrace();
 	net::io->stop();
     co_return;
 
@@ -335,14 +458,14 @@ static boost::asio::awaitable<void> runGame() {
         shutdown_game(1);
     }
     //create_schema();
+    */
 
     try {
-        //boot_db();
+        boot_db();
     } catch(std::exception& e) {
-        logger->info("Exception in boot_db(): %s", e.what());
+        logger->critical("Exception in boot_db(): {}", e.what());
         exit(1);
     }
-    */
 
 
     // Finally, let's get the game cracking.
@@ -387,6 +510,11 @@ void init_game() {
     }
 
     if(!gameFunc) {
+        if(!config::linkRecordFile.empty()) {
+            logger->info("Recording Link traffic to {}", config::linkRecordFile);
+            net::recorder = std::make_unique<net::LinkRecorder>(config::linkRecordFile);
+        }
+
         logger->info("Signal trapping.");
         net::signals = std::make_unique<boost::asio::signal_set>(*net::io, SIGUSR1, SIGUSR2);
 
@@ -421,6 +549,8 @@ void init_game() {
         threadCount = 0;
     }
 
+    watchdog::start();
+
     std::vector<std::thread> threads;
     if(threadCount) {
         logger->info("Starting {} helper threads...", threadCount);
@@ -451,6 +581,7 @@ void init_game() {
         thread.join();
     }
     logger->info("Executor has shut down. Running cleanup.");
+    watchdog::stop();
     logger->info("All threads joined.");
     threads.clear();
 
@@ -461,6 +592,7 @@ void init_game() {
     net::linkChannel.reset();
     net::signals.reset();
     net::link.reset();
+    net::recorder.reset();
 
     net::io.reset();
 
@@ -511,7 +643,10 @@ void PlayView::handle_input() {
                     input_queue.clear();
                     //write_to_output(this, "All queued commands cancelled.\r\n");
                 } else {
-                    //perform_alias(this, (char*)command.c_str());
+                    // perform_alias(): an alias expands into one or more queued commands.
+                    auto parsed = commands::registry.resolve(command, 0, &aliases);
+                    if(parsed.alias) commands::expandAlias(*parsed.alias, parsed.args, input_queue);
+                    else input_queue.push_back(command);
                 }
             }
         })) continue;
@@ -0,0 +1,270 @@
+#include "kai/commands.h"
+
+namespace commands {
+    CommandRegistry registry;
+
+    template<typename T>
+    int64_t PrefixTrie<T>::findChild(uint32_t node, char c) const {
+        auto& children = nodes[node].children;
+        auto it = std::lower_bound(children.begin(), children.end(), c, [](const auto& p, char ch) { return p.first < ch; });
+        if(it == children.end() || it->first != c) return -1;
+        return it->second;
+    }
+
+    template<typename T>
+    void PrefixTrie<T>::addBest(std::vector<Best>& best, Best b) {
+        // Skip it if something at or below its level already comes earlier.
+        for(auto& e : best) {
+            if(e.level <= b.level && e.order <= b.order) return;
+        }
+        auto pos = std::find_if(best.begin(), best.end(), [&](const Best& e) { return e.level >= b.level; });
+        pos = best.insert(pos, b);
+        // Anything at a higher level that comes later is now shadowed.
+        best.erase(std::remove_if(pos + 1, best.end(), [&](const Best& e) { return e.order >= b.order; }), best.end());
+    }
+
+    template<typename T>
+    void PrefixTrie<T>::link(uint32_t entryIndex) {
+        auto& e = entries[entryIndex];
+        Best b{e.level, e.order, entryIndex};
+        std::string_view key = e.key;
+        uint32_t node = 0;
+        size_t pos = 0;
+        addBest(nodes[0].best, b);
+
+        while(pos < key.size()) {
+            auto child = findChild(node, key[pos]);
+            if(child < 0) {
+                Node n;
+                n.label = std::string(key.substr(pos));
+                auto index = static_cast<uint32_t>(nodes.size());
+                nodes.push_back(std::move(n));
+                auto& children = nodes[node].children;
+                auto it = std::lower_bound(children.begin(), children.end(), key[pos], [](const auto& p, char ch) { return p.first < ch; });
+                children.insert(it, {key[pos], index});
+                node = index;
+                pos = key.size();
+                addBest(nodes[node].best, b);
+                break;
+            }
+
+            auto& label = nodes[child].label;
+            size_t common = 0;
+            while(common < label.size() && pos + common < key.size() && label[common] == key[pos + common]) common++;
+
+            if(common < label.size()) {
+                // Split the edge: a new middle node takes over the shared part of the label.
+                Node mid;
+                mid.label = label.substr(0, common);
+                mid.best = nodes[child].best;
+                nodes[child].label.erase(0, common);
+                mid.children.push_back({nodes[child].label[0], static_cast<uint32_t>(child)});
+                auto index = static_cast<uint32_t>(nodes.size());
+                nodes.push_back(std::move(mid));
+                for(auto& [c, i] : nodes[node].children) {
+                    if(i == child) i = index;
+                }
+                child = index;
+            }
+            node = child;
+            pos += common;
+            addBest(nodes[node].best, b);
+        }
+        nodes[node].entry = entryIndex;
+    }
+
+    template<typename T>
+    void PrefixTrie<T>::rebuild() {
+        std::vector<Entry> live;
+        for(auto& e : entries) {
+            if(e.live) live.push_back(std::move(e));
+        }
+        entries = std::move(live);
+        freeCount = 0;
+        nodes.clear();
+        nodes.emplace_back();
+        for(uint32_t i = 0; i < entries.size(); i++) link(i);
+    }
+
+    template<typename T>
+    void PrefixTrie<T>::insert(std::string_view key, T value, int level) {
+        if(key.empty()) return;
+        std::string lowered(key.size(), '\0');
+        std::transform(key.begin(), key.end(), lowered.begin(), lower);
+
+        bool partial = false;
+        auto node = walk(lowered, partial);
+        if(node >= 0 && !partial && nodes[node].entry >= 0) {
+            auto& e = entries[nodes[node].entry];
+            e.value = std::move(value);
+            if(e.level != level) {
+                e.level = level;
+                rebuild();
+            }
+            return;
+        }
+        entries.push_back(Entry{std::move(lowered), std::move(value), level, nextOrder++, true});
+        link(entries.size() - 1);
+    }
+
+    template<typename T>
+    void PrefixTrie<T>::erase(std::string_view key) {
+        bool partial = false;
+        auto node = walk(key, partial);
+        if(node < 0 || partial || nodes[node].entry < 0) return;
+        entries[nodes[node].entry].live = false;
+        freeCount++;
+        rebuild();
+    }
+
+    template<typename T>
+    void PrefixTrie<T>::clear() {
+        nodes.clear();
+        nodes.emplace_back();
+        entries.clear();
+        freeCount = 0;
+    }
+
+    template<typename T>
+    int64_t PrefixTrie<T>::walk(std::string_view key, bool& partial) const {
+        uint32_t node = 0;
+        size_t pos = 0;
+        partial = false;
+        while(pos < key.size()) {
+            auto child = findChild(node, lower(key[pos]));
+            if(child < 0) return -1;
+            auto& label = nodes[child].label;
+            auto n = std::min(label.size(), key.size() - pos);
+            for(size_t i = 0; i < n; i++) {
+                if(lower(key[pos + i]) != label[i]) return -1;
+            }
+            pos += n;
+            node = child;
+            if(n < label.size()) partial = true;
+        }
+        return node;
+    }
+
+    template<typename T>
+    const T* PrefixTrie<T>::bestFor(uint32_t node, int level) const {
+        const Best *found = nullptr;
+        for(auto& b : nodes[node].best) {
+            if(b.level > level) break;
+            found = &b;
+        }
+        return found ? &entries[found->entry].value : nullptr;
+    }
+
+    template<typename T>
+    const T* PrefixTrie<T>::exact(std::string_view key, int level) const {
+        bool partial = false;
+        auto node = walk(key, partial);
+        if(node <= 0 || partial || nodes[node].entry < 0) return nullptr;
+        auto& e = entries[nodes[node].entry];
+        return e.level <= level ? &e.value : nullptr;
+    }
+
+    template<typename T>
+    const T* PrefixTrie<T>::abbreviation(std::string_view prefix, int level) const {
+        if(prefix.empty()) return nullptr;
+        bool partial = false;
+        auto node = walk(prefix, partial);
+        if(node <= 0) return nullptr;
+        if(!partial && nodes[node].entry >= 0) {
+            auto& e = entries[nodes[node].entry];
+            if(e.level <= level) return &e.value;
+        }
+        return bestFor(node, level);
+    }
+
+    template class PrefixTrie<std::string>;
+    template class PrefixTrie<const Command*>;
+
+    std::string_view nextWord(std::string_view& text) {
+        auto start = text.find_first_not_of(" \t");
+        if(start == std::string_view::npos) {
+            text = {};
+            return {};
+        }
+        auto end = text.find_first_of(" \t", start);
+        auto word = text.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+        text = end == std::string_view::npos ? std::string_view{} : text.substr(end);
+        return word;
+    }
+
+    void AliasTable::set(std::string_view name, std::string expansion) {
+        trie.insert(name, std::move(expansion));
+    }
+
+    void AliasTable::remove(std::string_view name) {
+        trie.erase(name);
+    }
+
+    const std::string* AliasTable::find(std::string_view name) const {
+        return trie.exact(name);
+    }
+
+    const Command& CommandRegistry::add(std::string name, Handler handler, int minLevel) {
+        auto& cmd = commands.emplace_back(Command{std::move(name), std::move(handler), minLevel});
+        trie.insert(cmd.name, &cmd, minLevel);
+        return cmd;
+    }
+
+    ParsedCommand CommandRegistry::resolve(std::string_view input, int level, const AliasTable *aliases) const {
+        ParsedCommand out;
+        auto start = input.find_first_not_of(" \t");
+        if(start == std::string_view::npos) return out;
+        input.remove_prefix(start);
+
+        // Like Circle, a leading non-letter such as ' or : is a verb all by itself.
+        size_t verbLength;
+        if(!std::isalpha(static_cast<unsigned char>(input[0]))) verbLength = 1;
+        else verbLength = std::min(input.find_first_of(" \t"), input.size());
+        out.verb = input.substr(0, verbLength);
+
+        auto rest = input.substr(verbLength);
+        auto argStart = rest.find_first_not_of(" \t");
+        out.args = argStart == std::string_view::npos ? std::string_view{} : rest.substr(argStart);
+        auto words = out.args;
+        out.arg1 = nextWord(words);
+        out.arg2 = nextWord(words);
+
+        if(aliases) {
+            if(auto alias = aliases->find(out.verb)) {
+                out.alias = alias;
+                return out;
+            }
+        }
+        if(auto cmd = trie.abbreviation(out.verb, level)) out.command = *cmd;
+        return out;
+    }
+
+    void expandAlias(std::string_view expansion, std::string_view args, std::list<std::string>& out) {
+        std::array<std::string_view, 9> words{};
+        auto rest = args;
+        for(auto& w : words) w = nextWord(rest);
+
+        std::string current;
+        for(size_t i = 0; i < expansion.size(); i++) {
+            auto c = expansion[i];
+            if(c == ';') {
+                out.push_back(std::move(current));
+                current.clear();
+            } else if(c == '$' && i + 1 < expansion.size()) {
+                auto n = expansion[i + 1];
+                if(n == '*') {
+                    current += args;
+                    i++;
+                } else if(n >= '1' && n <= '9') {
+                    current += words[n - '1'];
+                    i++;
+                } else {
+                    current += c;
+                }
+            } else {
+                current += c;
+            }
+        }
+        out.push_back(std::move(current));
+    }
+}
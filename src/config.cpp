@@ -48,6 +48,7 @@ namespace config {
     bool enableMultithreading{true};
     int threadsCount{2};
     bool usingMultithreading{false};
+    bool parallelInput{false};
     std::chrono::milliseconds heartbeatInterval{100ms};
     std::string thermiteAddress{"127.0.0.1"};
     uint16_t thermitePort{7000};
@@ -55,7 +56,28 @@ namespace config {
 
     std::string assetDbName = "assets";
     std::string stateDbName = "state";
+    std::string modulesDirectory = "modules";
+    int bootThreads{0};
+    std::chrono::milliseconds persistenceInterval{1000ms};
+    size_t persistenceBatchSize{5000};
+    uint32_t deltaSavesPerFullSave{100};
+    int64_t residencyBudget{0};
+    int64_t moduleMemoryLimit{0};
+    size_t graphPathCacheSize{4096};
+    bool readViews{false};
+    std::string snapshotFile{"world.snapshot"};
+    size_t snapshotMaterializePerTick{2000};
+    std::string sqliteSynchronous{"NORMAL"};
+    int64_t sqliteMmapSize{256 * 1024 * 1024};
+    int64_t sqliteCacheSize{-64 * 1024};
+    std::chrono::milliseconds walCheckpointInterval{30000ms};
+    std::string journalFile{"assets.journal"};
+    int64_t journalSegmentSize{64 * 1024 * 1024};
     bool testMode{false};
     bool logEgregiousTimings{false};
+    std::chrono::seconds profilerWindow{60s};
+    std::string profilerTraceFile;
+    std::chrono::milliseconds watchdogThreshold{3000ms};
+    std::string linkRecordFile;
 
 }
@@ -10,9 +10,186 @@
 
 #include <fstream>
 #include "kai/db.h"
+#include "kai/config.h"
+#include "kai/storage.h"
+#include "kai/snapshot.h"
+#include "kai/journal.h"
+#include "kai/query.h"
 
 std::shared_ptr<SQLite::Database> assetDb, stateDb, logDb;
+std::map<std::string, std::shared_ptr<GameModule>> gameModules;
 
 std::shared_ptr<spdlog::logger> logger;
 bool gameIsLoading = true;
 bool saveAll = false;
+
+namespace {
+    using BootClock = std::chrono::steady_clock;
+
+    struct ModuleBoot {
+        std::filesystem::path folder;
+        std::shared_ptr<GameModule> module;
+        size_t fromDatabase{0}, fromFolder{0};
+        double databaseMs{0}, folderMs{0};
+        std::string error;
+        // the module's saved objects already came out of the snapshot, as shells.
+        bool fromSnapshot{false};
+    };
+
+    double msSince(BootClock::time_point start) {
+        return std::chrono::duration<double, std::milli>(BootClock::now() - start).count();
+    }
+
+    // First pass, on a pool thread: builds one module's objects from the database and from the
+    // objects.jsonl in its folder, leaving references unresolved. Saved state wins over the folder.
+    void bootModule(ModuleBoot& b, const std::string& dbPath) {
+        if(!b.module) {
+            b.module = std::make_shared<GameModule>(b.folder);
+            b.module->setPaged(config::residencyBudget > 0);
+        }
+        auto& name = b.module->getName();
+
+        auto start = BootClock::now();
+        std::set<int64_t> saved;
+        if(b.fromSnapshot) {
+            for(auto& [id, obj] : b.module->getGameObjects()) saved.insert(id);
+            // A paged snapshot leaves out what was only in the database; that still beats the folder.
+            if(b.module->isPaged()) {
+                storage::Store store(dbPath);
+                for(auto id : store.objectIds(name)) saved.insert(id);
+            }
+        } else if(b.module->isPaged()) {
+            storage::Store store(dbPath);
+            // Saved objects load on first use.
+            for(auto id : store.objectIds(name)) saved.insert(id);
+        } else {
+            storage::Store store(dbPath);
+            std::unordered_map<int64_t, std::vector<serial::FieldChange>> fields;
+            store.forEachField(name, [&](int64_t id, serial::FieldChange&& f) {
+                fields[id].push_back(std::move(f));
+            });
+            static const std::vector<serial::FieldChange> noFields;
+            store.forEachObject(name, [&](int64_t id, int64_t generation, std::string_view data) {
+                auto obj = b.module->createGameObject(id, generation).lock();
+                auto it = fields.find(id);
+                obj->loadDeferred(data, it == fields.end() ? noFields : it->second);
+                saved.insert(id);
+            });
+        }
+        b.fromDatabase = saved.size();
+        b.databaseMs = msSince(start);
+
+        start = BootClock::now();
+        std::ifstream in(b.folder / "objects.jsonl");
+        std::string line;
+        size_t lineNumber = 0;
+        while(in && std::getline(in, line)) {
+            lineNumber++;
+            if(line.empty()) continue;
+            auto j = nlohmann::json::parse(line, nullptr, false);
+            if(j.is_discarded() || !j.contains("id")) {
+                logger->warn("Boot: {}/objects.jsonl:{} is not a valid object.", name, lineNumber);
+                continue;
+            }
+            auto id = j["id"].get<int64_t>();
+            if(saved.contains(id)) continue;
+            auto obj = b.module->createGameObject(id, j.value("generation", int64_t(-1))).lock();
+            obj->loadDeferred(j);
+            b.fromFolder++;
+        }
+        b.folderMs = msSince(start);
+    }
+}
+
+void boot_db() {
+    auto bootStart = BootClock::now();
+    std::vector<ModuleBoot> boots;
+    if(std::filesystem::is_directory(config::modulesDirectory)) {
+        for(auto& entry : std::filesystem::directory_iterator(config::modulesDirectory)) {
+            if(entry.is_directory()) boots.emplace_back().folder = entry.path();
+        }
+    }
+    std::sort(boots.begin(), boots.end(), [](auto& a, auto& b) { return a.folder < b.folder; });
+
+    auto dbPath = fmt::format("{}.sqlite3", config::assetDbName);
+    {
+        storage::Store store(dbPath);
+        store.createSchema();
+        // A crash leaves the batches SQLite had not committed in the journal.
+        if(journal::replay(config::journalFile, store)) snapshot::markStale(store);
+    }
+
+    // Modules held by a valid snapshot start out as shells backed by the mapping; only their
+    // folders are read below.
+    if(snapshot::open(config::snapshotFile)) {
+        auto names = snapshot::createModules();
+        for(auto& b : boots) {
+            auto name = b.folder.filename().string();
+            if(!names.contains(name)) continue;
+            b.module = gameModules[name];
+            b.fromSnapshot = true;
+        }
+    }
+
+    size_t threads = config::bootThreads > 0 ? config::bootThreads : std::thread::hardware_concurrency();
+    threads = std::clamp<size_t>(threads, 1, std::max<size_t>(boots.size(), 1));
+    logger->info("Booting {} modules on {} threads.", boots.size(), threads);
+    {
+        boost::asio::thread_pool pool(threads);
+        for(auto& b : boots) {
+            boost::asio::post(pool, [&b, &dbPath] {
+                try {
+                    bootModule(b, dbPath);
+                } catch(const std::exception& e) {
+                    b.error = e.what();
+                }
+            });
+        }
+        pool.join();
+    }
+    auto loadMs = msSince(bootStart);
+
+    for(auto& b : boots) {
+        if(!b.error.empty()) {
+            throw std::runtime_error(fmt::format("Could not boot module {}: {}", b.folder.string(), b.error));
+        }
+        gameModules[b.module->getName()] = b.module;
+    }
+
+    // Second pass: every module exists now, so cross-module references resolve.
+    auto linkStart = BootClock::now();
+    for(auto& [name, module] : gameModules) {
+        // Resolving can add shells to a paged module, which moves its objects around; walk a
+        // copy. The new shells have nothing to resolve.
+        std::vector<std::shared_ptr<GameObject>> objects;
+        objects.reserve(module->getGameObjects().size());
+        for(auto& [id, obj] : module->getGameObjects()) objects.push_back(obj);
+        for(auto& obj : objects) obj->resolveReferences();
+    }
+    auto linkMs = msSince(linkStart);
+
+    // Declared indexes are built last, over every loaded object.
+    for(auto& b : boots) {
+        std::ifstream in(b.folder / "indexes.json");
+        if(!in) continue;
+        auto definitions = nlohmann::json::parse(in, nullptr, false);
+        if(definitions.is_discarded() || !definitions.is_array()) {
+            logger->warn("Boot: {}/indexes.json is not a JSON array.", b.module->getName());
+            continue;
+        }
+        auto created = query::createIndexes(*b.module, definitions);
+        logger->info("Boot: {} indexes on {}.", created, b.module->getName());
+    }
+
+    std::sort(boots.begin(), boots.end(), [](auto& a, auto& b) {
+        return a.databaseMs + a.folderMs > b.databaseMs + b.folderMs;
+    });
+    double moduleMs = 0;
+    for(auto& b : boots) {
+        moduleMs += b.databaseMs + b.folderMs;
+        logger->info("Boot: {:<24} {:>8.1f}ms  {:>7} saved objects ({:.1f}ms)  {:>7} from folder ({:.1f}ms)",
+                     b.module->getName(), b.databaseMs + b.folderMs, b.fromDatabase, b.databaseMs, b.fromFolder, b.folderMs);
+    }
+    logger->info("Boot: loaded modules in {:.1f}ms ({:.1f}ms of module work), linked references in {:.1f}ms, {:.1f}ms total.",
+                 loadMs, moduleMs, linkMs, msSince(bootStart));
+}
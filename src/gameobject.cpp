@@ -0,0 +1,1102 @@
+#include "kai/structs.h"
+#include "kai/config.h"
+#include "kai/residency.h"
+#include "kai/persistence.h"
+#include "kai/query.h"
+#include "kai/readview.h"
+#include "kai/graph.h"
+#include "kai/interest.h"
+
+GameModule::GameModule(std::filesystem::path folder) : name(folder.filename().string()), folder(std::move(folder)) {
+    m_memory = std::make_shared<memory::ModuleResource>(name);
+}
+
+GameModule::~GameModule() = default;
+
+const std::string& GameModule::getName() const {
+    return name;
+}
+
+memory::ModuleResource& GameModule::getMemory() const {
+    return *m_memory;
+}
+
+std::shared_lock<std::shared_mutex> GameModule::readObjects() const {
+    return m_paged ? std::shared_lock(m_objectsMutex) : std::shared_lock<std::shared_mutex>();
+}
+
+GameObject* GameModule::find(int64_t id, int64_t generation) {
+    if(auto obj = findInMemory(id)) {
+        if(generation != -1 && obj->getGeneration() != generation) return nullptr;
+        return obj;
+    }
+    if(!m_paged) return nullptr;
+    // Not in memory but still waiting to be written means removed; its row is about to go.
+    if(isDirty(id) || !persistence::isSettled(name, id)) return nullptr;
+    auto saved = residency::savedGeneration(name, id);
+    if(!saved || (generation != -1 && *saved != generation)) return nullptr;
+    return createShell(id, *saved).get();
+}
+
+void GameModule::insert(const std::shared_ptr<GameObject>& obj) {
+    // Detaching resolves links, possibly into this module, so it runs outside the lock.
+    if(auto old = findInMemory(obj->getID())) {
+        detach(*old);
+        std::unique_lock lock(m_objectsMutex);
+        m_gameObjects.erase(old->m_handle.slot);
+        m_slotsById.erase(obj->getID());
+    }
+    std::unique_lock lock(m_objectsMutex);
+    insertLocked(obj);
+}
+
+void GameModule::insertLocked(const std::shared_ptr<GameObject>& obj) {
+    auto id = obj->getID();
+    auto slot = m_gameObjects.insert({id, obj});
+    m_slotsById[id] = slot;
+    obj->m_handle = ObjectHandle{slot, obj->getGeneration()};
+    m_maxId = std::max(m_maxId, id);
+}
+
+std::weak_ptr<GameObject> GameModule::getGameObject(int64_t id, int64_t generation) {
+    auto obj = find(id, generation);
+    if(!obj) return {};
+    return obj->shared_from_this();
+}
+
+std::weak_ptr<GameObject> GameModule::createGameObject(int64_t id, int64_t generation) {
+    if(id == -1) {
+        id = m_maxId + 1;
+        if(m_paged) {
+            if(!m_savedMaxId) m_savedMaxId = residency::savedMaxId(name);
+            id = std::max(id, *m_savedMaxId + 1);
+        }
+    } else if(findInMemory(id)) {
+        throw std::runtime_error(fmt::format("GameObject {} already exists in module {}", id, name));
+    }
+    if(generation == -1) {
+        generation = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    auto obj = std::allocate_shared<GameObject>(memory::Allocator<GameObject>(m_memory), this, id, generation);
+    insert(obj);
+    markDirty(id);
+    return obj;
+}
+
+std::shared_ptr<GameObject> GameModule::createShell(int64_t id, int64_t generation) {
+    auto obj = std::allocate_shared<GameObject>(memory::Allocator<GameObject>(m_memory), this, id, generation);
+    obj->m_resident = false;
+    obj->m_linksLoaded = false;
+    obj->m_fullSave = false;
+    // Two partitions may reach for the same saved object at once; the first shell wins.
+    std::unique_lock lock(m_objectsMutex);
+    if(auto it = m_slotsById.find(id); it != m_slotsById.end()) return m_gameObjects.get(it->second)->second;
+    insertLocked(obj);
+    return obj;
+}
+
+bool GameModule::removeGameObject(int64_t id) {
+    auto obj = findInMemory(id);
+    if(!obj) return false;
+    detach(*obj);
+    {
+        std::unique_lock lock(m_objectsMutex);
+        m_gameObjects.erase(obj->m_handle.slot);
+        m_slotsById.erase(id);
+    }
+    markDirty(id);
+    return true;
+}
+
+void GameModule::detach(GameObject& obj) {
+    for(auto& r : obj.m_relations) {
+        if(obj.relationTarget(r)) r.module->unlinkReverse(r.target.slot.index, r.name, r.reverseSlot);
+    }
+    obj.m_relations.clear();
+    graph::objectRemoved(obj);
+    obj.linkParent(nullptr);
+    obj.linkOwner(nullptr);
+    // What it contained or owned is left loose, and saved that way.
+    auto release = [](GameObject& o, bool contents) {
+        contents ? o.linkParent(nullptr) : o.linkOwner(nullptr);
+        (contents ? o.m_parentChanged : o.m_ownerChanged) = true;
+        o.m_module->markDirty(o.m_id);
+    };
+    for(auto& link : std::vector(obj.m_contents)) {
+        if(auto child = link.resolve()) release(*child, true);
+    }
+    for(auto& link : std::vector(obj.m_possessions)) {
+        if(auto item = link.resolve()) release(*item, false);
+    }
+    for(auto& pool : m_components) {
+        if(pool) pool->remove(obj.m_handle);
+    }
+    for(auto& index : m_indexes) index->erase(obj.m_handle);
+    // Whatever points here goes stale along with the handle, so its edges can simply go.
+    auto slot = obj.m_handle.slot.index;
+    if(slot < m_reverse.size()) m_reverse[slot].clear();
+    interest::objectRemoved(obj);
+}
+
+uint32_t GameModule::linkReverse(uint32_t slot, symbols::Symbol name, ReverseEdge edge) {
+    if(slot >= m_reverse.size()) m_reverse.resize(slot + 1);
+    auto& entries = m_reverse[slot];
+    auto it = std::find_if(entries.begin(), entries.end(), [&](auto& e) { return e.name == name; });
+    if(it == entries.end()) it = entries.insert(entries.end(), ReverseEntry{name, {}});
+    it->sources.push_back(edge);
+    return static_cast<uint32_t>(it->sources.size() - 1);
+}
+
+void GameModule::unlinkReverse(uint32_t slot, symbols::Symbol name, uint32_t position) {
+    if(slot >= m_reverse.size()) return;
+    auto& entries = m_reverse[slot];
+    auto it = std::find_if(entries.begin(), entries.end(), [&](auto& e) { return e.name == name; });
+    if(it == entries.end() || position >= it->sources.size()) return;
+    auto& sources = it->sources;
+    if(position != sources.size() - 1) {
+        // The last edge moves into the hole; its source has to learn where it went.
+        sources[position] = sources.back();
+        if(auto moved = sources[position].module->resolve(sources[position].source)) {
+            for(auto& r : moved->m_relations) {
+                if(r.name == name && r.module == this && r.target.slot.index == slot) r.reverseSlot = position;
+            }
+        }
+    }
+    sources.pop_back();
+    if(sources.empty()) entries.erase(it);
+}
+
+const std::vector<GameModule::ReverseEdge>* GameModule::reverseEdges(uint32_t slot, symbols::Symbol name) const {
+    if(slot >= m_reverse.size()) return nullptr;
+    for(auto& e : m_reverse[slot]) {
+        if(e.name == name) return &e.sources;
+    }
+    return nullptr;
+}
+
+const ObjectSlots& GameModule::getGameObjects() const {
+    return m_gameObjects;
+}
+
+ObjectHandle GameModule::getHandle(int64_t id, int64_t generation) {
+    auto obj = find(id, generation);
+    return obj ? obj->m_handle : ObjectHandle{};
+}
+
+GameObject* GameModule::resolve(const ObjectHandle& handle) const {
+    auto lock = readObjects();
+    auto entry = m_gameObjects.get(handle.slot);
+    if(!entry || entry->second->getGeneration() != handle.generation) return nullptr;
+    return entry->second.get();
+}
+
+std::weak_ptr<GameObject> GameModule::getGameObject(const ObjectHandle& handle) const {
+    auto lock = readObjects();
+    auto entry = m_gameObjects.get(handle.slot);
+    if(!entry || entry->second->getGeneration() != handle.generation) return {};
+    return entry->second;
+}
+
+void GameModule::saveAll() {
+    std::lock_guard<std::mutex> lock(dirtyMutex);
+    for(auto& [id, obj] : m_gameObjects) {
+        // an evicted object's saved state is already current.
+        if(!obj->isResident()) continue;
+        obj->requestFullSave();
+        dirtyObjects.insert(id);
+    }
+}
+
+std::set<int64_t> GameModule::takeDirty() {
+    std::lock_guard<std::mutex> lock(dirtyMutex);
+    return std::exchange(dirtyObjects, {});
+}
+
+bool GameModule::isDirty(int64_t id) {
+    std::lock_guard<std::mutex> lock(dirtyMutex);
+    return dirtyObjects.contains(id);
+}
+
+void GameModule::markDirty(int64_t id) {
+    std::lock_guard<std::mutex> lock(dirtyMutex);
+    dirtyObjects.insert(id);
+    if(readview::enabled()) viewChanges.push_back(id);
+}
+
+std::vector<int64_t> GameModule::takeViewChanges() {
+    std::lock_guard<std::mutex> lock(dirtyMutex);
+    return std::exchange(viewChanges, {});
+}
+
+GameObject* GameModule::findInMemory(int64_t id) const {
+    auto lock = readObjects();
+    auto it = m_slotsById.find(id);
+    return it != m_slotsById.end() ? m_gameObjects.get(it->second)->second.get() : nullptr;
+}
+
+void GameModule::clearDirty(int64_t id) {
+    std::lock_guard<std::mutex> lock(dirtyMutex);
+    dirtyObjects.erase(id);
+}
+
+void GameModule::setPaged(bool paged) {
+    m_paged = paged;
+}
+
+bool GameModule::isPaged() const {
+    return m_paged;
+}
+
+query::Index& GameModule::createIndex(const query::Attribute& attribute, query::IndexKind kind) {
+    for(auto& index : m_indexes) {
+        if(index->getAttribute() == attribute && index->getKind() == kind) return *index;
+    }
+    auto& index = m_indexes.emplace_back(query::makeIndex(attribute, kind));
+    for(auto& [id, obj] : m_gameObjects) {
+        if(!obj->isResident()) continue;
+        if(auto value = query::valueOf(*obj, attribute)) index->assign(obj->m_handle, &*value);
+    }
+    return *index;
+}
+
+const query::Index* GameModule::findIndex(const query::Attribute& attribute, bool ordered) const {
+    for(auto& index : m_indexes) {
+        if(index->getAttribute() == attribute && (!ordered || index->getKind() == query::IndexKind::Ordered)) return index.get();
+    }
+    return nullptr;
+}
+
+bool GameModule::dropIndex(const query::Attribute& attribute, query::IndexKind kind) {
+    return std::erase_if(m_indexes, [&](auto& index) {
+        return index->getAttribute() == attribute && index->getKind() == kind;
+    }) > 0;
+}
+
+static nlohmann::json serializeRef(const GameObject* obj) {
+    nlohmann::json j;
+    j["module"] = obj->getModule()->getName();
+    j["id"] = obj->getID();
+    j["generation"] = obj->getGeneration();
+    return j;
+}
+
+static std::shared_ptr<GameObject> resolveRef(const nlohmann::json& j) {
+    auto it = gameModules.find(j["module"].get<std::string>());
+    if(it == gameModules.end()) return nullptr;
+    return it->second->getGameObject(j["id"].get<int64_t>(), j["generation"].get<int64_t>()).lock();
+}
+
+static constexpr uint32_t objectFormatVersion = 1;
+
+// A reference as stored in a blob: the module name is an interned key, so references into the
+// same module cost a byte plus the id and generation.
+struct BinaryRef {
+    std::string_view module;
+    int64_t id{0};
+    int64_t generation{0};
+};
+
+static void writeRef(serial::Writer& w, const GameObject* obj) {
+    w.key(obj->getModule()->getName());
+    w.svarint(obj->getID());
+    w.svarint(obj->getGeneration());
+}
+
+static BinaryRef readRef(serial::Reader& r) {
+    BinaryRef ref;
+    ref.module = r.key();
+    ref.id = r.svarint();
+    ref.generation = r.svarint();
+    return ref;
+}
+
+// The value of a reference field in a delta row; it has no key table to intern into.
+static std::string encodeRef(const std::shared_ptr<GameObject>& obj) {
+    serial::Writer w;
+    w.str(obj->getModule()->getName());
+    w.svarint(obj->getID());
+    w.svarint(obj->getGeneration());
+    return w.finishBare();
+}
+
+static BinaryRef decodeRef(std::string_view value) {
+    serial::Reader r(value);
+    BinaryRef ref;
+    ref.module = r.str();
+    ref.id = r.svarint();
+    ref.generation = r.svarint();
+    return ref;
+}
+
+static nlohmann::json refToJson(const BinaryRef& ref) {
+    nlohmann::json j;
+    j["module"] = ref.module;
+    j["id"] = ref.id;
+    j["generation"] = ref.generation;
+    return j;
+}
+
+static std::shared_ptr<GameObject> resolveRef(const BinaryRef& ref) {
+    auto it = gameModules.find(std::string(ref.module));
+    if(it == gameModules.end()) return nullptr;
+    return it->second->getGameObject(ref.id, ref.generation).lock();
+}
+
+// Everything a blob holds, before its references are resolved. Views point into the blob.
+struct DecodedObject {
+    int64_t id{0};
+    int64_t generation{0};
+    std::optional<BinaryRef> parent, owner;
+    std::vector<std::pair<std::string_view, BinaryRef>> relations;
+    AttributeManager<double> stats;
+    AttributeManager<std::string> strings;
+};
+
+static DecodedObject decodeObject(std::string_view blob) {
+    serial::Reader r(blob, serial::Kind::GameObject);
+    if(r.version() > objectFormatVersion) {
+        throw serial::Error(fmt::format("GameObject blob version {} is newer than this server ({})", r.version(), objectFormatVersion));
+    }
+    DecodedObject out;
+    out.id = r.svarint();
+    out.generation = r.svarint();
+
+    uint32_t tag;
+    serial::Reader field;
+    while(r.nextField(tag, field)) {
+        switch(static_cast<ObjectField>(tag)) {
+            case ObjectField::Parent:
+                out.parent = readRef(field);
+                break;
+            case ObjectField::Owner:
+                out.owner = readRef(field);
+                break;
+            case ObjectField::Relations: {
+                auto count = field.varint();
+                out.relations.reserve(count);
+                for(uint64_t i = 0; i < count; i++) {
+                    auto name = field.key();
+                    out.relations.emplace_back(name, readRef(field));
+                }
+                break;
+            }
+            case ObjectField::Stats:
+                out.stats.decode(field);
+                break;
+            case ObjectField::Strings:
+                out.strings.decode(field);
+                break;
+            default:
+                // written by a newer server; nothing we can do with it.
+                break;
+        }
+    }
+    return out;
+}
+
+GameObject::GameObject(GameModule *module, int64_t id, int64_t generation)
+    : m_module(module), m_id(id), m_generation(generation), m_contents(&module->getMemory()), m_possessions(&module->getMemory()),
+      m_stats(&module->getMemory()), m_strings(&module->getMemory()) {
+    m_stats.trackChanges(true);
+    m_strings.trackChanges(true);
+
+}
+
+std::string GameObject::renderID() const {
+    return fmt::format("#{}:{}:{}", m_module->getName(), m_id, m_generation);
+}
+
+int64_t GameObject::getID() const {
+    return m_id;
+}
+
+int64_t GameObject::getGeneration() const {
+    return m_generation;
+}
+
+ObjectHandle GameObject::getHandle() const {
+    return m_handle;
+}
+
+GameModule* GameObject::getModule() const {
+    return m_module;
+}
+
+nlohmann::json GameObject::serialize() {
+    touch();
+    nlohmann::json j;
+    j["id"] = m_id;
+    j["generation"] = m_generation;
+    if(auto p = m_parent.resolve()) j["parent"] = serializeRef(p);
+    if(auto o = m_owner.resolve()) j["owner"] = serializeRef(o);
+    for(auto& r : m_relations) {
+        if(auto target = relationTarget(r)) j["relations"][symbols::name(r.name)] = serializeRef(target);
+    }
+    if(!m_stats.empty()) j["stats"] = m_stats.serialize();
+    if(!m_strings.empty()) j["strings"] = m_strings.serialize();
+    return j;
+}
+
+void GameObject::deserialize(const nlohmann::json& j) {
+    touch();
+    if(j.contains("parent")) setParent(resolveRef(j["parent"]));
+    if(j.contains("owner")) setOwner(resolveRef(j["owner"]));
+    if(j.contains("relations")) {
+        for(auto& [name, ref] : j["relations"].items()) {
+            auto target = resolveRef(ref);
+            if(!target) {
+                logger->warn("{}: could not resolve relation '{}' to {}", renderID(), name, ref.dump());
+                continue;
+            }
+            setRelation(name, target);
+        }
+    }
+    if(j.contains("stats")) m_stats.deserialize(j["stats"]);
+    if(j.contains("strings")) m_strings.deserialize(j["strings"]);
+    reindexAll();
+    m_fullSave = true;
+}
+
+std::string GameObject::serializeBinary() const {
+    touch();
+    serial::Writer w;
+    w.svarint(m_id);
+    w.svarint(m_generation);
+    if(auto p = m_parent.resolve()) {
+        auto mark = w.beginField(static_cast<uint32_t>(ObjectField::Parent));
+        writeRef(w, p);
+        w.endField(mark);
+    }
+    if(auto o = m_owner.resolve()) {
+        auto mark = w.beginField(static_cast<uint32_t>(ObjectField::Owner));
+        writeRef(w, o);
+        w.endField(mark);
+    }
+    if(!m_relations.empty()) {
+        boost::container::small_vector<std::pair<symbols::Symbol, GameObject*>, 8> live;
+        for(auto& r : m_relations) {
+            if(auto target = relationTarget(r)) live.emplace_back(r.name, target);
+        }
+        auto mark = w.beginField(static_cast<uint32_t>(ObjectField::Relations));
+        w.varint(live.size());
+        for(auto& [name, target] : live) {
+            w.key(symbols::name(name));
+            writeRef(w, target);
+        }
+        w.endField(mark);
+    }
+    if(!m_stats.empty()) {
+        auto mark = w.beginField(static_cast<uint32_t>(ObjectField::Stats));
+        m_stats.encode(w);
+        w.endField(mark);
+    }
+    if(!m_strings.empty()) {
+        auto mark = w.beginField(static_cast<uint32_t>(ObjectField::Strings));
+        m_strings.encode(w);
+        w.endField(mark);
+    }
+    return w.finish(serial::Kind::GameObject, objectFormatVersion);
+}
+
+void GameObject::deserializeBinary(std::string_view blob) {
+    touch();
+    auto d = decodeObject(blob);
+    if(d.parent) setParent(resolveRef(*d.parent));
+    if(d.owner) setOwner(resolveRef(*d.owner));
+    for(auto& [name, ref] : d.relations) {
+        auto target = resolveRef(ref);
+        if(!target) {
+            logger->warn("{}: could not resolve relation '{}' to {}", renderID(), name, refToJson(ref).dump());
+            continue;
+        }
+        setRelation(std::string(name), target);
+    }
+    // A wholesale replacement the attributes' change tracking cannot describe, so the next save
+    // is a full one.
+    m_stats = std::move(d.stats);
+    m_strings = std::move(d.strings);
+    m_stats.trackChanges(true);
+    m_strings.trackChanges(true);
+    reindexAll();
+    m_fullSave = true;
+}
+
+// A reference that outlives the blob or JSON it was read from.
+struct StoredRef {
+    std::string module;
+    int64_t id{0};
+    int64_t generation{0};
+
+    StoredRef(const BinaryRef& ref) : module(ref.module), id(ref.id), generation(ref.generation) {}
+    StoredRef(const nlohmann::json& j) : module(j["module"].get<std::string>()), id(j["id"].get<int64_t>()),
+                                         generation(j["generation"].get<int64_t>()) {}
+};
+
+struct GameObject::PendingReferences {
+    std::optional<StoredRef> parent, owner;
+    std::map<std::string, StoredRef> relations;
+    bool fromDatabase{false};
+};
+
+GameObject::~GameObject() = default;
+
+void GameObject::loadDeferred(std::string_view blob, const std::vector<serial::FieldChange>& fields) {
+    auto d = decodeObject(blob);
+    auto p = std::make_unique<PendingReferences>();
+    p->fromDatabase = true;
+    if(d.parent) p->parent.emplace(*d.parent);
+    if(d.owner) p->owner.emplace(*d.owner);
+    for(auto& [name, ref] : d.relations) p->relations.insert_or_assign(std::string(name), StoredRef(ref));
+    m_stats = std::move(d.stats);
+    m_strings = std::move(d.strings);
+    m_stats.trackChanges(true);
+    m_strings.trackChanges(true);
+
+    // Delta rows override the blob, exactly as applyChange() would.
+    for(auto& f : fields) {
+        auto ref = [&]() -> std::optional<StoredRef> {
+            if(!f.value) return std::nullopt;
+            return StoredRef(decodeRef(*f.value));
+        };
+        switch(static_cast<ObjectField>(f.field)) {
+            case ObjectField::Parent:
+                p->parent = ref();
+                break;
+            case ObjectField::Owner:
+                p->owner = ref();
+                break;
+            case ObjectField::Relations:
+                if(f.value) p->relations.insert_or_assign(f.name, *ref());
+                else p->relations.erase(f.name);
+                break;
+            case ObjectField::Stats:
+            case ObjectField::Strings:
+                applyChange(f);
+                break;
+            default:
+                logger->warn("{}: ignoring a saved change to unknown field {}", renderID(), f.field);
+                break;
+        }
+    }
+    reindexAll();
+    m_pending = std::move(p);
+}
+
+void GameObject::loadDeferred(const nlohmann::json& j) {
+    auto p = std::make_unique<PendingReferences>();
+    if(j.contains("parent")) p->parent.emplace(j["parent"]);
+    if(j.contains("owner")) p->owner.emplace(j["owner"]);
+    if(j.contains("relations")) {
+        for(auto& [name, ref] : j["relations"].items()) p->relations.insert_or_assign(name, StoredRef(ref));
+    }
+    if(j.contains("stats")) m_stats.deserialize(j["stats"]);
+    if(j.contains("strings")) m_strings.deserialize(j["strings"]);
+    reindexAll();
+    m_pending = std::move(p);
+}
+
+void GameObject::resolveReferences() {
+    if(!m_pending) return;
+    auto p = std::move(m_pending);
+    auto resolve = [&](const StoredRef& ref) {
+        auto target = resolveRef(BinaryRef{ref.module, ref.id, ref.generation});
+        if(!target) logger->warn("{}: could not resolve reference to #{}:{}:{}", renderID(), ref.module, ref.id, ref.generation);
+        return target;
+    };
+    if(p->parent) setParent(resolve(*p->parent));
+    if(p->owner) setOwner(resolve(*p->owner));
+    for(auto& [name, ref] : p->relations) {
+        if(auto target = resolve(ref)) setRelation(name, target);
+    }
+    if(p->fromDatabase) {
+        clearChanges();
+        m_module->clearDirty(m_id);
+    }
+}
+
+nlohmann::json GameObject::exportJson(std::string_view blob) {
+    auto d = decodeObject(blob);
+    nlohmann::json j;
+    j["id"] = d.id;
+    j["generation"] = d.generation;
+    if(d.parent) j["parent"] = refToJson(*d.parent);
+    if(d.owner) j["owner"] = refToJson(*d.owner);
+    for(auto& [name, ref] : d.relations) j["relations"][std::string(name)] = refToJson(ref);
+    if(!d.stats.empty()) j["stats"] = d.stats.serialize();
+    if(!d.strings.empty()) j["strings"] = d.strings.serialize();
+    return j;
+}
+
+bool GameObject::hasChanges() const {
+    return m_fullSave || m_parentChanged || m_ownerChanged || !m_changedRelations.empty()
+        || m_stats.hasChanges() || m_strings.hasChanges();
+}
+
+bool GameObject::isResident() const {
+    return m_resident;
+}
+
+void GameObject::ensureResident() const {
+    touch();
+}
+
+uint64_t GameObject::lastTouched() const {
+    return m_lastTouched.load(std::memory_order_relaxed);
+}
+
+void GameObject::touch() const {
+    m_lastTouched.store(residency::clock.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    if(!m_resident) const_cast<GameObject*>(this)->reload();
+}
+
+void GameObject::reload() {
+    // Resident first: loading goes through the setters, which touch() again.
+    m_resident = true;
+    bool dirty = m_module->isDirty(m_id);
+    if(!residency::load(*this)) {
+        logger->warn("{}: could not be loaded from the database.", renderID());
+    }
+    if(!dirty) m_module->clearDirty(m_id);
+    if(readview::enabled()) {
+        std::lock_guard<std::mutex> lock(m_module->dirtyMutex);
+        m_module->viewChanges.push_back(m_id);
+    }
+}
+
+void GameObject::restore(std::string_view blob, const std::vector<serial::FieldChange>& fields) {
+    auto d = decodeObject(blob);
+    // Links are kept through eviction and may have changed since the save: removing a container
+    // releases its contents without loading them. Only a shell that was never loaded takes its
+    // links from the save, and what it records while doing so is not a change.
+    bool links = !m_linksLoaded;
+    auto parentChanged = m_parentChanged, ownerChanged = m_ownerChanged;
+    auto changedRelations = m_changedRelations;
+    if(links) {
+        if(d.parent) setParent(resolveRef(*d.parent));
+        if(d.owner) setOwner(resolveRef(*d.owner));
+        for(auto& [name, ref] : d.relations) {
+            if(auto target = resolveRef(ref)) setRelation(std::string(name), target);
+            else logger->warn("{}: could not resolve relation '{}' to {}", renderID(), name, refToJson(ref).dump());
+        }
+    }
+    m_stats = std::move(d.stats);
+    m_strings = std::move(d.strings);
+    m_stats.trackChanges(true);
+    m_strings.trackChanges(true);
+    for(auto& f : fields) {
+        auto field = static_cast<ObjectField>(f.field);
+        bool link = field == ObjectField::Parent || field == ObjectField::Owner || field == ObjectField::Relations;
+        if(links || !link) applyChange(f);
+    }
+    // The attributes were dropped on eviction, so every change they hold came from the load.
+    m_stats.takeChanges();
+    m_strings.takeChanges();
+    m_parentChanged = parentChanged;
+    m_ownerChanged = ownerChanged;
+    m_changedRelations = std::move(changedRelations);
+    reindexAll();
+    m_linksLoaded = true;
+}
+
+bool GameObject::evict() {
+    if(!m_resident || hasChanges() || m_module->isDirty(m_id)) return false;
+    // Parent, owner and relations stay: they are only a few handles, and they are the edges of
+    // the containment and reverse relation indexes, which outlive the eviction.
+    m_stats.clear();
+    m_strings.clear();
+    m_resident = false;
+    noteEncodedSize(0);
+    return true;
+}
+
+void GameObject::noteEncodedSize(size_t bytes) {
+    if(!m_module->isPaged()) return;
+    // decoded objects take a few times the size of their encoding.
+    int64_t estimate = bytes ? static_cast<int64_t>(sizeof(GameObject) + bytes * 4) : 0;
+    residency::residentBytes.fetch_add(estimate - m_residentBytes, std::memory_order_relaxed);
+    m_residentBytes = estimate;
+}
+
+bool GameObject::needsFullSave() const {
+    return m_fullSave || m_deltaSaves >= config::deltaSavesPerFullSave;
+}
+
+void GameObject::requestFullSave() {
+    m_fullSave = true;
+}
+
+std::vector<serial::FieldChange> GameObject::takeChanges() {
+    std::vector<serial::FieldChange> out;
+    auto refChange = [&](ObjectField field, const std::string& name, const std::shared_ptr<GameObject>& target) {
+        auto& c = out.emplace_back();
+        c.field = static_cast<uint32_t>(field);
+        c.name = name;
+        if(target) c.value = encodeRef(target);
+    };
+    auto linked = [](const ObjectLink& link) {
+        auto obj = link.resolve();
+        return obj ? obj->shared_from_this() : nullptr;
+    };
+    if(m_parentChanged) refChange(ObjectField::Parent, "", linked(m_parent));
+    if(m_ownerChanged) refChange(ObjectField::Owner, "", linked(m_owner));
+    for(auto name : m_changedRelations) refChange(ObjectField::Relations, symbols::name(name), getRelation(name));
+
+    auto attributeChanges = [&]<typename T>(ObjectField field, AttributeManager<T>& attributes) {
+        for(auto& [category, name] : attributes.takeChanges()) {
+            auto& c = out.emplace_back();
+            c.field = static_cast<uint32_t>(field);
+            c.category = category;
+            c.name = name;
+            if(attributes.has(category, name)) {
+                serial::Writer w;
+                serial::writeValue(w, attributes.get(category, name));
+                c.value = w.finishBare();
+            }
+        }
+    };
+    attributeChanges(ObjectField::Stats, m_stats);
+    attributeChanges(ObjectField::Strings, m_strings);
+
+    m_fullSave = m_parentChanged = m_ownerChanged = false;
+    m_changedRelations.clear();
+    if(!out.empty()) m_deltaSaves++;
+    return out;
+}
+
+void GameObject::clearChanges() {
+    m_fullSave = m_parentChanged = m_ownerChanged = false;
+    m_deltaSaves = 0;
+    m_changedRelations.clear();
+    m_stats.takeChanges();
+    m_strings.takeChanges();
+}
+
+void GameObject::applyChange(const serial::FieldChange& change) {
+    touch();
+    auto target = [&]() -> std::shared_ptr<GameObject> {
+        return change.value ? resolveRef(decodeRef(*change.value)) : nullptr;
+    };
+    auto attribute = [&]<typename T>(AttributeManager<T>& attributes) {
+        if(change.value) {
+            serial::Reader r(*change.value);
+            attributes.set(change.category, change.name, serial::readValue<T>(r));
+        } else {
+            attributes.remove(change.category, change.name);
+        }
+        reindex(static_cast<ObjectField>(change.field), symbols::find(change.category), symbols::find(change.name));
+        m_module->markDirty(m_id);
+    };
+    switch(static_cast<ObjectField>(change.field)) {
+        case ObjectField::Parent:
+            setParent(target());
+            break;
+        case ObjectField::Owner:
+            setOwner(target());
+            break;
+        case ObjectField::Relations:
+            setRelation(change.name, target());
+            break;
+        case ObjectField::Stats:
+            attribute(m_stats);
+            break;
+        case ObjectField::Strings:
+            attribute(m_strings);
+            break;
+        default:
+            logger->warn("{}: ignoring a saved change to unknown field {}", renderID(), change.field);
+            break;
+    }
+}
+
+double GameObject::getStat(const std::string& category, const std::string& name, double defaultValue) const {
+    touch();
+    return m_stats.get(category, name, defaultValue);
+}
+
+void GameObject::setStat(const std::string& category, const std::string& name, double value) {
+    touch();
+    auto c = symbols::intern(category), n = symbols::intern(name);
+    m_stats.set(c, n, value);
+    reindex(ObjectField::Stats, c, n);
+    m_module->markDirty(m_id);
+}
+
+std::string GameObject::getString(const std::string& category, const std::string& name, const std::string& defaultValue) const {
+    touch();
+    return m_strings.get(category, name, defaultValue);
+}
+
+void GameObject::setString(const std::string& category, const std::string& name, const std::string& value) {
+    touch();
+    auto c = symbols::intern(category), n = symbols::intern(name);
+    m_strings.set(c, n, value);
+    reindex(ObjectField::Strings, c, n);
+    m_module->markDirty(m_id);
+}
+
+const double* GameObject::findStat(symbols::Symbol category, symbols::Symbol name) const {
+    return m_stats.find(category, name);
+}
+
+const std::string* GameObject::findString(symbols::Symbol category, symbols::Symbol name) const {
+    return m_strings.find(category, name);
+}
+
+void GameObject::reindex(ObjectField field, symbols::Symbol category, symbols::Symbol name) {
+    for(auto& index : m_module->m_indexes) {
+        auto& a = index->getAttribute();
+        if(a.field != field || a.category != category || a.name != name) continue;
+        auto value = query::valueOf(*this, a);
+        index->assign(m_handle, value ? &*value : nullptr);
+    }
+}
+
+void GameObject::reindexAll() {
+    for(auto& index : m_module->m_indexes) {
+        auto value = query::valueOf(*this, index->getAttribute());
+        index->assign(m_handle, value ? &*value : nullptr);
+    }
+}
+
+GameObject::Relation* GameObject::findRelation(symbols::Symbol name) {
+    for(auto& r : m_relations) {
+        if(r.name == name) return &r;
+    }
+    return nullptr;
+}
+
+const GameObject::Relation* GameObject::findRelation(symbols::Symbol name) const {
+    return const_cast<GameObject*>(this)->findRelation(name);
+}
+
+ObjectLink GameObject::relationLink(symbols::Symbol name) const {
+    auto r = findRelation(name);
+    return r ? ObjectLink{r->module, r->target} : ObjectLink{};
+}
+
+GameObject* GameObject::relationTarget(const Relation& r) const {
+    return r.module->resolve(r.target);
+}
+
+std::shared_ptr<GameObject> GameObject::getRelation(const std::string& name) const {
+    auto symbol = symbols::find(name);
+    if(symbol == symbols::none) {
+        touch();
+        return nullptr;
+    }
+    return getRelation(symbol);
+}
+
+std::shared_ptr<GameObject> GameObject::getRelation(symbols::Symbol name) const {
+    touch();
+    auto r = findRelation(name);
+    if(!r) return nullptr;
+    auto target = relationTarget(*r);
+    return target ? target->shared_from_this() : nullptr;
+}
+
+void GameObject::setRelation(const std::string& name, std::shared_ptr<GameObject> target) {
+    setRelation(symbols::intern(name), std::move(target));
+}
+
+void GameObject::setRelation(symbols::Symbol name, std::shared_ptr<GameObject> target) {
+    touch();
+    // A removed object can no longer be pointed at.
+    if(target && !target->getModule()->resolve(target->getHandle())) target.reset();
+    auto r = findRelation(name);
+    if(r && !(target && r->module == target->getModule() && r->target == target->getHandle())) {
+        if(relationTarget(*r)) r->module->unlinkReverse(r->target.slot.index, name, r->reverseSlot);
+        if(target) {
+            r->module = target->getModule();
+            r->target = target->getHandle();
+            r->reverseSlot = r->module->linkReverse(r->target.slot.index, name, {m_module, m_handle});
+        } else {
+            *r = m_relations.back();
+            m_relations.pop_back();
+        }
+    } else if(!r && target) {
+        auto module = target->getModule();
+        auto handle = target->getHandle();
+        auto position = module->linkReverse(handle.slot.index, name, {m_module, m_handle});
+        m_relations.push_back(Relation{name, position, module, handle});
+    }
+    if(std::find(m_changedRelations.begin(), m_changedRelations.end(), name) == m_changedRelations.end()) {
+        m_changedRelations.push_back(name);
+    }
+    graph::relationChanged(*this, name);
+    m_module->markDirty(m_id);
+}
+
+std::set<std::shared_ptr<GameObject>> GameObject::getReverseRelation(const std::string& name) const {
+    auto symbol = symbols::find(name);
+    if(symbol == symbols::none) return {};
+    return getReverseRelation(symbol);
+}
+
+std::set<std::shared_ptr<GameObject>> GameObject::getReverseRelation(symbols::Symbol name) const {
+    std::set<std::shared_ptr<GameObject>> out;
+    auto edges = m_module->reverseEdges(m_handle.slot.index, name);
+    if(!edges) return out;
+    for(auto& e : *edges) {
+        if(auto obj = e.module->resolve(e.source)) out.insert(obj->shared_from_this());
+    }
+    return out;
+}
+
+uint32_t nextComponentId() {
+    static std::atomic<uint32_t> next{0};
+    return next++;
+}
+
+std::shared_ptr<const readview::ObjectView> GameObject::capture() const {
+    auto refOf = [](const GameObject* obj) {
+        return readview::Ref{obj->getModule()->getName(), obj->getID(), obj->getGeneration()};
+    };
+    auto view = std::make_shared<readview::ObjectView>();
+    view->id = m_id;
+    view->generation = m_generation;
+    if(auto p = m_parent.resolve()) view->parent = refOf(p);
+    if(auto o = m_owner.resolve()) view->owner = refOf(o);
+    for(auto& r : m_relations) {
+        if(auto target = relationTarget(r)) view->relations.emplace_back(symbols::name(r.name), refOf(target));
+    }
+    view->stats = m_stats;
+    view->strings = m_strings;
+    view->stats.trackChanges(false);
+    view->strings.trackChanges(false);
+    return view;
+}
+
+GameObject* ObjectLink::resolve() const {
+    return module ? module->resolve(handle) : nullptr;
+}
+
+namespace {
+    // Swap-removes entry position of a containment list; the entry moved into the hole learns
+    // its new position through slot.
+    void unlinkEntry(std::pmr::vector<ObjectLink>& list, uint32_t position, uint32_t GameObject::*slot) {
+        if(position >= list.size()) return;
+        if(position != list.size() - 1) {
+            list[position] = list.back();
+            if(auto moved = list[position].resolve()) moved->*slot = position;
+        }
+        list.pop_back();
+    }
+}
+
+void GameObject::linkParent(GameObject* parent) {
+    auto old = m_parent.resolve();
+    if(old == parent) return;
+    if(old) {
+        unlinkEntry(old->m_contents, m_parentSlot, &GameObject::m_parentSlot);
+        for(auto a = old; a; a = a->m_parent.resolve()) a->m_subtreeCount -= m_subtreeCount + 1;
+    }
+    m_parent = {};
+    if(parent && parent->m_module->resolve(parent->m_handle)) {
+        m_parent = ObjectLink{parent->m_module, parent->m_handle};
+        m_parentSlot = static_cast<uint32_t>(parent->m_contents.size());
+        parent->m_contents.push_back(ObjectLink{m_module, m_handle});
+        for(auto a = parent; a; a = a->m_parent.resolve()) a->m_subtreeCount += m_subtreeCount + 1;
+    }
+    interest::parentChanged(*this);
+}
+
+void GameObject::linkOwner(GameObject* owner) {
+    auto old = m_owner.resolve();
+    if(old == owner) return;
+    if(old) unlinkEntry(old->m_possessions, m_ownerSlot, &GameObject::m_ownerSlot);
+    m_owner = {};
+    if(!owner || !owner->m_module->resolve(owner->m_handle)) return;
+    m_owner = ObjectLink{owner->m_module, owner->m_handle};
+    m_ownerSlot = static_cast<uint32_t>(owner->m_possessions.size());
+    owner->m_possessions.push_back(ObjectLink{m_module, m_handle});
+}
+
+std::shared_ptr<GameObject> GameObject::getOwner() const {
+    touch();
+    auto owner = m_owner.resolve();
+    return owner ? owner->shared_from_this() : nullptr;
+}
+
+void GameObject::setOwner(std::shared_ptr<GameObject> owner) {
+    touch();
+    linkOwner(owner.get());
+    m_ownerChanged = true;
+    m_module->markDirty(m_id);
+}
+
+ObjectLink GameObject::parentLink() const {
+    return m_parent;
+}
+
+std::shared_ptr<GameObject> GameObject::getParent() const {
+    touch();
+    auto parent = m_parent.resolve();
+    return parent ? parent->shared_from_this() : nullptr;
+}
+
+void GameObject::setParent(std::shared_ptr<GameObject> parent) {
+    touch();
+    for(auto a = parent.get(); a; a = a->m_parent.resolve()) {
+        if(a == this) {
+            logger->warn("{}: cannot be put inside {}, which it contains.", renderID(), parent->renderID());
+            return;
+        }
+    }
+    linkParent(parent.get());
+    m_parentChanged = true;
+    m_module->markDirty(m_id);
+}
+
+std::vector<std::shared_ptr<GameObject>> GameObject::getContents() const {
+    std::vector<std::shared_ptr<GameObject>> out;
+    out.reserve(m_contents.size());
+    for(auto& link : m_contents) {
+        if(auto obj = link.resolve()) out.push_back(obj->shared_from_this());
+    }
+    return out;
+}
+
+std::vector<std::shared_ptr<GameObject>> GameObject::getPossessions() const {
+    std::vector<std::shared_ptr<GameObject>> out;
+    out.reserve(m_possessions.size());
+    for(auto& link : m_possessions) {
+        if(auto obj = link.resolve()) out.push_back(obj->shared_from_this());
+    }
+    return out;
+}
+
+size_t GameObject::contentsCount() const {
+    return m_contents.size();
+}
+
+size_t GameObject::subtreeCount() const {
+    return m_subtreeCount;
+}
+
+GameObject::Descendants GameObject::descendants() const {
+    return Descendants(this);
+}
+
+GameObject::Descendants::iterator GameObject::Descendants::begin() const {
+    iterator it;
+    it.stack.emplace_back(root, 0);
+    it.advance();
+    return it;
+}
+
+void GameObject::Descendants::iterator::advance() {
+    while(!stack.empty()) {
+        auto& [obj, next] = stack.back();
+        if(next >= obj->m_contents.size()) {
+            stack.pop_back();
+            continue;
+        }
+        auto child = obj->m_contents[next++].resolve();
+        if(!child) continue;
+        current = child;
+        stack.emplace_back(child, 0);
+        return;
+    }
+    current = nullptr;
+}
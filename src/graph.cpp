@@ -0,0 +1,426 @@
+#include "kai/graph.h"
+#include "kai/config.h"
+#include <queue>
+
+namespace graph {
+
+    namespace {
+        constexpr uint32_t none = UINT32_MAX;
+        // past this many regained-edge intervals, they are folded into lastAddition.
+        constexpr size_t maxGains = 256;
+
+        // Graphs are created and destroyed by the game thread, never while input partitions run,
+        // so the hooks can walk this without a lock.
+        std::vector<Graph*> registry;
+    }
+
+    Graph::Graph(const std::vector<std::string>& relations, const std::vector<std::string>& modules) {
+        for(auto& name : relations) this->relations.push_back(symbols::intern(name));
+        for(auto& name : modules) {
+            auto it = gameModules.find(name);
+            if(it == gameModules.end()) {
+                logger->warn("Graph: no module named {}.", name);
+                continue;
+            }
+            this->modules.push_back(it->second.get());
+        }
+        // naming only missing modules must not widen the graph to all of them.
+        if(!modules.empty() && this->modules.empty()) this->modules.push_back(nullptr);
+        rebuild();
+        registry.push_back(this);
+    }
+
+    Graph::~Graph() {
+        std::erase(registry, this);
+    }
+
+    bool Graph::covers(const GameModule* module) const {
+        return modules.empty() || std::find(modules.begin(), modules.end(), module) != modules.end();
+    }
+
+    bool Graph::watches(symbols::Symbol name) const {
+        return std::find(relations.begin(), relations.end(), name) != relations.end();
+    }
+
+    uint32_t Graph::nodeFor(GameModule* module, const ObjectHandle& handle, bool create) {
+        auto index = handle.slot.index;
+        auto it = nodeBySlot.find(module);
+        if(it != nodeBySlot.end() && index < it->second.size() && it->second[index] != none) {
+            // a removed object's node is unmapped, so a mismatch means the handle is the stale one.
+            auto node = it->second[index];
+            return nodes[node].handle == handle ? node : none;
+        }
+        if(!create || !module->resolve(handle)) return none;
+
+        auto& slots = nodeBySlot[module];
+        if(index >= slots.size()) slots.resize(index + 1, none);
+        auto node = static_cast<uint32_t>(nodes.size());
+        slots[index] = node;
+        nodes.push_back(ObjectLink{module, handle});
+        dead.push_back(false);
+        patched.push_back(false);
+        lostEdgeAt.push_back(0);
+        return node;
+    }
+
+    void Graph::edgesOf(const GameObject& obj, std::vector<Edge>& out) {
+        for(auto name : relations) {
+            auto link = obj.relationLink(name);
+            if(!link.module || !covers(link.module)) continue;
+            if(auto target = nodeFor(link.module, link.handle, true); target != none) out.push_back(Edge{target, name});
+        }
+    }
+
+    std::span<const Graph::Edge> Graph::neighbours(uint32_t node) const {
+        if(patched[node]) return overlay.at(node);
+        if(node >= csrNodes) return {};
+        return {edges.data() + offsets[node], offsets[node + 1] - offsets[node]};
+    }
+
+    void Graph::rebuild() {
+        std::lock_guard lock(mutex);
+        nodes.clear();
+        dead.clear();
+        patched.clear();
+        lostEdgeAt.clear();
+        nodeBySlot.clear();
+        overlay.clear();
+        gaps.clear();
+        gains.clear();
+        lru.clear();
+        cache.clear();
+
+        std::vector<std::pair<uint32_t, Edge>> found;
+        std::vector<Edge> scratch;
+        for(auto& [name, module] : gameModules) {
+            if(!covers(module.get())) continue;
+            for(auto& [id, obj] : module->getGameObjects()) {
+                scratch.clear();
+                edgesOf(*obj, scratch);
+                if(scratch.empty()) continue;
+                auto source = nodeFor(module.get(), obj->getHandle(), true);
+                for(auto& e : scratch) found.emplace_back(source, e);
+            }
+        }
+
+        // counting sort by source into the CSR arrays.
+        csrNodes = static_cast<uint32_t>(nodes.size());
+        offsets.assign(csrNodes + 1, 0);
+        for(auto& [source, e] : found) offsets[source + 1]++;
+        for(uint32_t i = 0; i < csrNodes; i++) offsets[i + 1] += offsets[i];
+        edges.resize(found.size());
+        auto fill = std::vector<uint32_t>(offsets.begin(), offsets.end() - 1);
+        for(auto& [source, e] : found) edges[fill[source]++] = e;
+
+        lastAddition = ++version;
+        rebuilds++;
+    }
+
+    void Graph::compact() {
+        // Renumbers the live nodes, leaving the removed ones behind.
+        std::vector<uint32_t> renumber(nodes.size(), none);
+        uint32_t live = 0;
+        for(uint32_t n = 0; n < nodes.size(); n++) {
+            if(!dead[n]) renumber[n] = live++;
+        }
+
+        std::vector<uint32_t> newOffsets(live + 1, 0);
+        std::vector<Edge> newEdges;
+        newEdges.reserve(edges.size() + overlay.size() * 2);
+        std::vector<ObjectLink> newNodes;
+        newNodes.reserve(live);
+        std::vector<uint64_t> newLost;
+        newLost.reserve(live);
+        for(uint32_t n = 0; n < nodes.size(); n++) {
+            if(dead[n]) continue;
+            for(auto& e : neighbours(n)) {
+                if(!dead[e.target]) newEdges.push_back(Edge{renumber[e.target], e.label});
+            }
+            newOffsets[renumber[n] + 1] = static_cast<uint32_t>(newEdges.size());
+            newNodes.push_back(nodes[n]);
+            newLost.push_back(lostEdgeAt[n]);
+        }
+
+        for(auto& [module, slots] : nodeBySlot) {
+            for(auto& node : slots) {
+                if(node != none) node = renumber[node];
+            }
+        }
+        std::unordered_map<uint32_t, std::vector<Gap>> newGaps;
+        for(auto& [node, list] : gaps) {
+            if(renumber[node] == none) continue;
+            auto& kept = newGaps[renumber[node]];
+            for(auto& g : list) {
+                if(renumber[g.edge.target] != none) kept.push_back(Gap{Edge{renumber[g.edge.target], g.edge.label}, g.since});
+            }
+        }
+        // Cached paths move along with their nodes; the ones through a removed node are gone
+        // anyway.
+        cache.clear();
+        for(auto it = lru.begin(); it != lru.end();) {
+            auto from = renumber[it->key >> 32], to = renumber[it->key & UINT32_MAX];
+            bool alive = from != none && to != none;
+            for(auto& node : it->nodes) {
+                if(!alive) break;
+                alive = renumber[node] != none;
+                node = renumber[node];
+            }
+            if(!alive) {
+                it = lru.erase(it);
+                continue;
+            }
+            it->key = (static_cast<uint64_t>(from) << 32) | to;
+            cache[it->key] = it;
+            ++it;
+        }
+
+        nodes = std::move(newNodes);
+        lostEdgeAt = std::move(newLost);
+        gaps = std::move(newGaps);
+        offsets = std::move(newOffsets);
+        edges = std::move(newEdges);
+        csrNodes = live;
+        dead.assign(live, false);
+        patched.assign(live, false);
+        overlay.clear();
+        rebuilds++;
+    }
+
+    void Graph::updateNode(const GameObject& obj) {
+        std::vector<Edge> now;
+        edgesOf(obj, now);
+        auto node = nodeFor(obj.getModule(), obj.getHandle(), !now.empty());
+        if(node == none) return;
+
+        auto before = neighbours(node);
+        auto contains = [](std::span<const Edge> in, const Edge& e) { return std::find(in.begin(), in.end(), e) != in.end(); };
+        std::vector<Edge> gained, lost;
+        for(auto& e : now) {
+            if(!contains(before, e)) gained.push_back(e);
+        }
+        for(auto& e : before) {
+            if(!contains(now, e)) lost.push_back(e);
+        }
+        if(gained.empty() && lost.empty()) return;
+
+        if(!lost.empty()) {
+            lostEdgeAt[node] = ++version;
+            auto& missing = gaps[node];
+            for(auto& e : lost) missing.push_back(Gap{e, version});
+        }
+        if(!gained.empty()) {
+            auto at = ++version;
+            auto it = gaps.find(node);
+            for(auto& e : gained) {
+                if(it == gaps.end()) {
+                    lastAddition = at;
+                    continue;
+                }
+                auto& missing = it->second;
+                auto gap = std::find_if(missing.begin(), missing.end(), [&](auto& g) { return g.edge == e; });
+                if(gap == missing.end()) {
+                    lastAddition = at;
+                    continue;
+                }
+                gains.emplace_back(gap->since, at);
+                *gap = missing.back();
+                missing.pop_back();
+            }
+            if(it != gaps.end() && it->second.empty()) gaps.erase(it);
+            if(gains.size() > maxGains) pruneGains();
+        }
+        overlay[node] = std::move(now);
+        patched[node] = true;
+    }
+
+    void Graph::pruneGains() {
+        // Intervals that ended before the oldest cached path can no longer spoil anything.
+        auto oldest = version;
+        for(auto& entry : lru) oldest = std::min(oldest, entry.version);
+        std::erase_if(gains, [&](auto& g) { return g.second <= oldest; });
+        if(gains.size() > maxGains) {
+            lastAddition = version;
+            gains.clear();
+        }
+    }
+
+    void Graph::onRelationChanged(const GameObject& obj, symbols::Symbol name) {
+        if(!watches(name) || !covers(obj.getModule())) return;
+        std::lock_guard lock(mutex);
+        updateNode(obj);
+    }
+
+    void Graph::onRemoved(const GameObject& obj) {
+        if(!covers(obj.getModule())) return;
+        std::lock_guard lock(mutex);
+        auto node = nodeFor(obj.getModule(), obj.getHandle(), false);
+        if(node == none) return;
+        // edges into a dead node stay until the next compaction; searches step around them.
+        dead[node] = true;
+        overlay[node].clear();
+        patched[node] = true;
+        lostEdgeAt[node] = ++version;
+        nodeBySlot[obj.getModule()][obj.getHandle().slot.index] = none;
+    }
+
+    bool Graph::cacheValid(const CachedPath& entry) const {
+        if(lastAddition > entry.version) return false;
+        for(auto& [since, to] : gains) {
+            if(since <= entry.version && entry.version < to) return false;
+        }
+        for(auto node : entry.nodes) {
+            if(dead[node] || lostEdgeAt[node] > entry.version) return false;
+        }
+        return true;
+    }
+
+    Path Graph::toPath(const std::vector<uint32_t>& path, const std::vector<symbols::Symbol>& steps) const {
+        Path out;
+        out.rooms.reserve(path.size());
+        for(auto node : path) out.rooms.push_back(nodes[node]);
+        out.steps = steps;
+        return out;
+    }
+
+    bool Graph::search(uint32_t from, uint32_t to, const SearchOptions& options, const GameObject& goal,
+                       std::vector<uint32_t>& path, std::vector<symbols::Symbol>& steps) {
+        if(visitMark.size() < nodes.size()) {
+            visitMark.resize(nodes.size(), 0);
+            parent.resize(nodes.size());
+            distance.resize(nodes.size());
+            parentLabel.resize(nodes.size());
+        }
+        if(++visitStamp == 0) {
+            std::fill(visitMark.begin(), visitMark.end(), 0);
+            visitStamp = 1;
+        }
+        auto visit = [&](uint32_t node, uint32_t from, symbols::Symbol label, uint32_t depth) {
+            visitMark[node] = visitStamp;
+            parent[node] = from;
+            parentLabel[node] = label;
+            distance[node] = depth;
+        };
+        visit(from, none, symbols::none, 0);
+
+        bool found = false;
+        if(!options.heuristic) {
+            std::vector<uint32_t> frontier{from}, next;
+            for(uint32_t depth = 0; !found && !frontier.empty() && depth < options.maxDepth; depth++) {
+                next.clear();
+                for(auto node : frontier) {
+                    for(auto& e : neighbours(node)) {
+                        if(visitMark[e.target] == visitStamp || dead[e.target]) continue;
+                        visit(e.target, node, e.label, depth + 1);
+                        if(e.target == to) {
+                            found = true;
+                            break;
+                        }
+                        next.push_back(e.target);
+                    }
+                    if(found) break;
+                }
+                std::swap(frontier, next);
+            }
+        } else {
+            auto estimate = [&](uint32_t node) -> uint32_t {
+                auto obj = nodes[node].resolve();
+                return obj ? options.heuristic(*obj, goal) : 0;
+            };
+            // (estimated total, steps so far, node), cheapest first.
+            using Entry = std::tuple<uint32_t, uint32_t, uint32_t>;
+            std::priority_queue<Entry, std::vector<Entry>, std::greater<>> open;
+            open.emplace(estimate(from), 0, from);
+            while(!open.empty()) {
+                auto [f, g, node] = open.top();
+                open.pop();
+                if(g > distance[node]) continue;
+                if(node == to) {
+                    found = true;
+                    break;
+                }
+                if(g >= options.maxDepth) continue;
+                for(auto& e : neighbours(node)) {
+                    if(dead[e.target]) continue;
+                    if(visitMark[e.target] == visitStamp && distance[e.target] <= g + 1) continue;
+                    visit(e.target, node, e.label, g + 1);
+                    open.emplace(g + 1 + estimate(e.target), g + 1, e.target);
+                }
+            }
+        }
+        if(!found) return false;
+
+        for(auto node = to; node != none; node = parent[node]) {
+            path.push_back(node);
+            if(node != from) steps.push_back(parentLabel[node]);
+        }
+        std::reverse(path.begin(), path.end());
+        std::reverse(steps.begin(), steps.end());
+        return true;
+    }
+
+    Path Graph::findPath(const GameObject& from, const GameObject& to, const SearchOptions& options) {
+        if(&from == &to) return Path{{ObjectLink{from.getModule(), from.getHandle()}}, {}};
+        std::lock_guard lock(mutex);
+        if(overlay.size() > 64 + nodes.size() / 8) compact();
+        auto a = nodeFor(from.getModule(), from.getHandle(), false);
+        auto b = nodeFor(to.getModule(), to.getHandle(), false);
+        if(a == none || b == none) return {};
+
+        bool cacheable = options.useCache && options.maxDepth == UINT32_MAX && config::graphPathCacheSize > 0;
+        auto key = (static_cast<uint64_t>(a) << 32) | b;
+        if(cacheable) {
+            if(auto it = cache.find(key); it != cache.end()) {
+                if(cacheValid(*it->second)) {
+                    cacheHits++;
+                    lru.splice(lru.begin(), lru, it->second);
+                    return toPath(it->second->nodes, it->second->steps);
+                }
+                lru.erase(it->second);
+                cache.erase(it);
+            }
+            cacheMisses++;
+        }
+
+        std::vector<uint32_t> path;
+        std::vector<symbols::Symbol> steps;
+        search(a, b, options, to, path, steps);
+        auto out = toPath(path, steps);
+        if(cacheable) {
+            lru.push_front(CachedPath{key, version, std::move(path), std::move(steps)});
+            cache[key] = lru.begin();
+            while(lru.size() > config::graphPathCacheSize) {
+                cache.erase(lru.back().key);
+                lru.pop_back();
+            }
+        }
+        return out;
+    }
+
+    symbols::Symbol Graph::nextStep(const GameObject& from, const GameObject& to, uint32_t maxDepth) {
+        SearchOptions options;
+        options.maxDepth = maxDepth;
+        auto path = findPath(from, to, options);
+        return path.steps.empty() ? symbols::none : path.steps.front();
+    }
+
+    Stats Graph::stats() const {
+        std::lock_guard lock(mutex);
+        Stats s;
+        s.nodes = nodes.size() - std::count(dead.begin(), dead.end(), true);
+        for(uint32_t n = 0; n < nodes.size(); n++) s.edges += neighbours(n).size();
+        s.overlayNodes = overlay.size();
+        s.cachedPaths = lru.size();
+        s.cacheHits = cacheHits;
+        s.cacheMisses = cacheMisses;
+        s.rebuilds = rebuilds;
+        return s;
+    }
+
+    void relationChanged(const GameObject& obj, symbols::Symbol name) {
+        for(auto g : registry) g->onRelationChanged(obj, name);
+    }
+
+    void objectRemoved(const GameObject& obj) {
+        for(auto g : registry) g->onRemoved(obj);
+    }
+}
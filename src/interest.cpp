@@ -0,0 +1,223 @@
+#include "kai/interest.h"
+
+namespace interest {
+
+    namespace {
+        // Unordered; removal moves the last view into the hole.
+        using Views = std::vector<PlayView*>;
+
+        void remove(Views& views, PlayView* view) {
+            auto it = std::find(views.begin(), views.end(), view);
+            if(it == views.end()) return;
+            *it = views.back();
+            views.pop_back();
+        }
+
+        struct Place {
+            // views whose characters are directly inside, and anywhere inside (those included).
+            Views inside, within;
+        };
+
+        struct Watch {
+            const GameObject* body{nullptr};
+            // the containers around body, innermost first.
+            std::vector<const GameObject*> chain;
+            const GameModule* zone{nullptr};
+            std::vector<std::string> channels;
+        };
+
+        std::mutex mutex;
+        // the number of observed bodies, readable without the lock, so the hooks cost nothing
+        // while nobody is playing.
+        std::atomic<size_t> observed{0};
+        std::unordered_map<PlayView*, Watch> watches;
+        std::unordered_map<const GameObject*, Views> bodies;
+        std::unordered_map<const GameObject*, Place> places;
+        std::unordered_map<const GameModule*, Views> zones;
+        std::map<std::string, Views, std::less<>> channels;
+
+        std::vector<const GameObject*> chainOf(const GameObject* body) {
+            std::vector<const GameObject*> chain;
+            if(!body) return chain;
+            for(auto p = body->parentLink().resolve(); p; p = p->parentLink().resolve()) chain.push_back(p);
+            return chain;
+        }
+
+        void leavePlace(const GameObject* place, PlayView* view, bool inside) {
+            auto it = places.find(place);
+            if(it == places.end()) return;
+            if(inside) remove(it->second.inside, view);
+            else remove(it->second.within, view);
+            // when the room around a view moves, the view stays inside it while leaving within.
+            if(it->second.within.empty() && it->second.inside.empty()) places.erase(it);
+        }
+
+        // Files view under where its body is now, touching only the levels that changed: walking
+        // between two rooms of an area leaves the area's views alone.
+        void place(PlayView* view, Watch& watch) {
+            auto chain = chainOf(watch.body);
+            auto& old = watch.chain;
+            size_t common = 0;
+            while(common < old.size() && common < chain.size() && old[old.size() - 1 - common] == chain[chain.size() - 1 - common]) common++;
+
+            bool sameRoom = !old.empty() && !chain.empty() && old.front() == chain.front();
+            if(!old.empty() && !sameRoom) leavePlace(old.front(), view, true);
+            for(size_t i = 0; i < old.size() - common; i++) leavePlace(old[i], view, false);
+            for(size_t i = 0; i < chain.size() - common; i++) places[chain[i]].within.push_back(view);
+            if(!chain.empty() && !sameRoom) places[chain.front()].inside.push_back(view);
+
+            // the same rule as PlayView::getZone().
+            const GameModule* zone = nullptr;
+            if(watch.body) zone = chain.empty() ? watch.body->getModule() : chain.front()->getModule();
+            if(zone != watch.zone) {
+                if(auto it = zones.find(watch.zone); it != zones.end()) {
+                    remove(it->second, view);
+                    if(it->second.empty()) zones.erase(it);
+                }
+                if(zone) zones[zone].push_back(view);
+                watch.zone = zone;
+            }
+            watch.chain = std::move(chain);
+        }
+
+        void dropBody(PlayView* view, Watch& watch) {
+            if(!watch.body) return;
+            if(auto it = bodies.find(watch.body); it != bodies.end()) {
+                remove(it->second, view);
+                if(it->second.empty()) bodies.erase(it);
+            }
+            watch.body = nullptr;
+            place(view, watch);
+        }
+
+        Views copy(const Views* views) {
+            return views ? *views : Views{};
+        }
+
+        size_t deliver(const Views& views, const std::string& txt, const PlayView* except) {
+            size_t sent = 0;
+            for(auto view : views) {
+                if(view == except) continue;
+                view->sendText(txt);
+                sent++;
+            }
+            return sent;
+        }
+    }
+
+    void observe(PlayView& view, const GameObject& body) {
+        std::lock_guard lock(mutex);
+        auto& watch = watches[&view];
+        if(watch.body == &body) return;
+        dropBody(&view, watch);
+        watch.body = &body;
+        bodies[&body].push_back(&view);
+        place(&view, watch);
+        observed.store(bodies.size(), std::memory_order_relaxed);
+    }
+
+    void forget(PlayView& view) {
+        std::lock_guard lock(mutex);
+        auto it = watches.find(&view);
+        if(it == watches.end()) return;
+        dropBody(&view, it->second);
+        for(auto& name : it->second.channels) {
+            if(auto c = channels.find(name); c != channels.end()) {
+                remove(c->second, &view);
+                if(c->second.empty()) channels.erase(c);
+            }
+        }
+        watches.erase(it);
+        observed.store(bodies.size(), std::memory_order_relaxed);
+    }
+
+    void join(PlayView& view, std::string_view channel) {
+        std::lock_guard lock(mutex);
+        auto& joined = watches[&view].channels;
+        if(std::find(joined.begin(), joined.end(), channel) != joined.end()) return;
+        joined.emplace_back(channel);
+        auto it = channels.find(channel);
+        if(it == channels.end()) it = channels.emplace(std::string(channel), Views{}).first;
+        it->second.push_back(&view);
+    }
+
+    void leave(PlayView& view, std::string_view channel) {
+        std::lock_guard lock(mutex);
+        auto w = watches.find(&view);
+        if(w == watches.end()) return;
+        auto& joined = w->second.channels;
+        auto j = std::find(joined.begin(), joined.end(), channel);
+        if(j == joined.end()) return;
+        joined.erase(j);
+        if(auto it = channels.find(channel); it != channels.end()) {
+            remove(it->second, &view);
+            if(it->second.empty()) channels.erase(it);
+        }
+    }
+
+    std::vector<PlayView*> inside(const GameObject& place) {
+        std::lock_guard lock(mutex);
+        auto it = places.find(&place);
+        return copy(it != places.end() ? &it->second.inside : nullptr);
+    }
+
+    std::vector<PlayView*> within(const GameObject& place) {
+        std::lock_guard lock(mutex);
+        auto it = places.find(&place);
+        return copy(it != places.end() ? &it->second.within : nullptr);
+    }
+
+    std::vector<PlayView*> inZone(const GameModule& zone) {
+        std::lock_guard lock(mutex);
+        auto it = zones.find(&zone);
+        return copy(it != zones.end() ? &it->second : nullptr);
+    }
+
+    std::vector<PlayView*> onChannel(std::string_view channel) {
+        std::lock_guard lock(mutex);
+        auto it = channels.find(channel);
+        return copy(it != channels.end() ? &it->second : nullptr);
+    }
+
+    // The recipients are copied out first, so sendText() runs without the lock.
+    size_t sendInside(const GameObject& place, const std::string& txt, const PlayView* except) {
+        return deliver(inside(place), txt, except);
+    }
+
+    size_t sendWithin(const GameObject& place, const std::string& txt, const PlayView* except) {
+        return deliver(within(place), txt, except);
+    }
+
+    size_t sendToZone(const GameModule& zone, const std::string& txt, const PlayView* except) {
+        return deliver(inZone(zone), txt, except);
+    }
+
+    size_t sendToChannel(std::string_view channel, const std::string& txt, const PlayView* except) {
+        return deliver(onChannel(channel), txt, except);
+    }
+
+    Stats stats() {
+        std::lock_guard lock(mutex);
+        return Stats{watches.size(), places.size(), zones.size(), channels.size()};
+    }
+
+    void parentChanged(const GameObject& obj) {
+        if(observed.load(std::memory_order_relaxed) == 0) return;
+        std::lock_guard lock(mutex);
+        // a character that moved, or a container with characters somewhere inside it.
+        Views moved;
+        if(auto it = bodies.find(&obj); it != bodies.end()) moved = it->second;
+        if(auto it = places.find(&obj); it != places.end()) moved.insert(moved.end(), it->second.within.begin(), it->second.within.end());
+        for(auto view : moved) place(view, watches[view]);
+    }
+
+    void objectRemoved(const GameObject& obj) {
+        if(observed.load(std::memory_order_relaxed) == 0) return;
+        std::lock_guard lock(mutex);
+        auto it = bodies.find(&obj);
+        if(it == bodies.end()) return;
+        // the views stay on their channels until they observe a new body or are forgotten.
+        for(auto view : Views(it->second)) dropBody(view, watches[view]);
+        observed.store(bodies.size(), std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,336 @@
+#include "kai/journal.h"
+#include "kai/config.h"
+#include <bit>
+#include <charconv>
+#include <deque>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace journal {
+    static_assert(std::endian::native == std::endian::little, "journal frames are written in host byte order");
+
+    namespace {
+        constexpr uint32_t formatVersion = 1;
+
+        enum RecordFlags : uint8_t {
+            Full = 1,
+            Deleted = 2
+        };
+
+        // length of the payload, CRC-32 of seq and payload, seq.
+        struct FrameHeader {
+            uint32_t length;
+            uint32_t crc;
+            uint64_t seq;
+        };
+
+        constexpr auto crcTable = [] {
+            std::array<uint32_t, 256> table{};
+            for(uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for(int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[i] = c;
+            }
+            return table;
+        }();
+
+        uint32_t crc32(std::string_view data, uint32_t crc = 0) {
+            crc = ~crc;
+            for(auto ch : data) crc = crcTable[(crc ^ static_cast<uint8_t>(ch)) & 0xFF] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        uint32_t frameCrc(uint64_t seq, std::string_view payload) {
+            return crc32(payload, crc32(std::string_view(reinterpret_cast<const char*>(&seq), sizeof(seq))));
+        }
+
+        struct Segment {
+            std::filesystem::path path;
+            uint64_t lastSeq{0};
+        };
+
+        // Segments of path, oldest first.
+        std::vector<std::pair<uint64_t, std::filesystem::path>> listSegments(const std::filesystem::path& path) {
+            std::vector<std::pair<uint64_t, std::filesystem::path>> out;
+            auto dir = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+            auto prefix = path.filename().string() + ".";
+            if(!std::filesystem::is_directory(dir)) return out;
+            for(auto& entry : std::filesystem::directory_iterator(dir)) {
+                auto name = entry.path().filename().string();
+                if(!name.starts_with(prefix)) continue;
+                auto suffix = std::string_view(name).substr(prefix.size());
+                uint64_t index = 0;
+                auto [end, ec] = std::from_chars(suffix.data(), suffix.data() + suffix.size(), index);
+                if(ec != std::errc() || end != suffix.data() + suffix.size()) continue;
+                out.emplace_back(index, entry.path());
+            }
+            std::sort(out.begin(), out.end());
+            return out;
+        }
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool running{false};
+        // frames handed over but not written yet, and the highest seq among them.
+        std::string queued;
+        uint64_t queuedSeq{0}, appendedSeq{0};
+        uint64_t releasedSeq{0}, prunedSeq{0};
+
+        // Only touched by the sync thread once it runs.
+        std::filesystem::path basePath;
+        std::deque<Segment> closedSegments;
+        Segment current;
+        int fd{-1};
+        uint64_t currentSize{0}, nextIndex{1};
+
+        bool openSegment() {
+            current = Segment{fmt::format("{}.{:06}", basePath.string(), nextIndex++)};
+            currentSize = 0;
+            fd = ::open(current.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+            if(fd < 0) {
+                logger->error("Journal: could not open {}: {}", current.path.string(), strerror(errno));
+                return false;
+            }
+            return true;
+        }
+
+        // Set while the last group of frames could not be made durable.
+        bool degraded{false};
+
+        // Appends frames to the current segment and syncs them. On failure the segment is cut
+        // back to its last good frame, so replay never stops short of frames written after it.
+        bool writeAll(std::string_view frames) {
+            auto good = currentSize;
+            auto fail = [&](const char* what) {
+                logger->error("Journal: {} of {} failed: {}", what, current.path.string(), strerror(errno));
+                if(::ftruncate(fd, static_cast<off_t>(good)) != 0) {
+                    logger->error("Journal: could not cut {} back to {} bytes: {}", current.path.string(), good, strerror(errno));
+                }
+                currentSize = good;
+                return false;
+            };
+            while(!frames.empty()) {
+                auto n = ::write(fd, frames.data(), frames.size());
+                if(n < 0) {
+                    if(errno == EINTR) continue;
+                    return fail("write");
+                }
+                frames.remove_prefix(n);
+                currentSize += n;
+            }
+            // The group commit: one sync for everything that queued up meanwhile.
+            if(::fdatasync(fd) != 0) return fail("sync");
+            return true;
+        }
+
+        void closeSegment() {
+            ::close(fd);
+            fd = -1;
+            if(currentSize > 0) closedSegments.push_back(current);
+            else std::filesystem::remove(current.path);
+        }
+
+        void writeFrames(std::string_view frames, uint64_t seq) {
+            bool ok = (fd >= 0 || openSegment()) && writeAll(frames);
+            if(!ok) {
+                // After a failed write or sync the file's state is unknown; try once more in a
+                // fresh segment.
+                if(fd >= 0) closeSegment();
+                ok = openSegment() && writeAll(frames);
+            }
+            if(!ok) {
+                if(!degraded) {
+                    logger->error("Journal: frames up to seq {} are not on disk. Until the database commits them, a crash "
+                                  "loses them; the journal keeps trying with the next tick.", seq);
+                }
+                degraded = true;
+                return;
+            }
+            if(degraded) logger->info("Journal: writing again from seq {}.", seq);
+            degraded = false;
+            current.lastSeq = seq;
+            if(currentSize >= static_cast<uint64_t>(config::journalSegmentSize)) {
+                closeSegment();
+                openSegment();
+            }
+        }
+
+        void prune(uint64_t released) {
+            while(!closedSegments.empty() && closedSegments.front().lastSeq <= released) {
+                std::error_code ec;
+                std::filesystem::remove(closedSegments.front().path, ec);
+                closedSegments.pop_front();
+            }
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true) {
+                wake.wait(lock, [] { return !running || !queued.empty() || releasedSeq != prunedSeq; });
+                auto frames = std::exchange(queued, {});
+                auto seq = queuedSeq;
+                auto released = prunedSeq = releasedSeq;
+                bool stopping = !running;
+                lock.unlock();
+                if(!frames.empty()) writeFrames(frames, seq);
+                prune(released);
+                lock.lock();
+                if(stopping && queued.empty()) break;
+            }
+        }
+
+        void decode(std::string_view payload, std::map<std::pair<std::string, int64_t>, ObjectRecord>& out) {
+            serial::Reader r(payload, serial::Kind::JournalBatch);
+            if(r.version() > formatVersion) throw serial::Error(fmt::format("journal batch version {} is newer than this build", r.version()));
+            auto count = r.varint();
+            for(uint64_t i = 0; i < count; i++) {
+                ObjectRecord rec;
+                rec.module = r.key();
+                rec.id = r.svarint();
+                rec.generation = r.svarint();
+                auto flags = r.u8();
+                rec.full = flags & Full;
+                rec.deleted = flags & Deleted;
+                if(rec.full) {
+                    rec.data = r.str();
+                } else if(!rec.deleted) {
+                    auto fields = r.varint();
+                    for(uint64_t f = 0; f < fields; f++) {
+                        auto& change = rec.fields.emplace_back();
+                        change.field = static_cast<uint32_t>(r.varint());
+                        change.category = r.key();
+                        change.name = r.str();
+                        if(r.u8()) change.value = std::string(r.str());
+                    }
+                }
+                auto [it, inserted] = out.try_emplace({rec.module, rec.id}, std::move(rec));
+                if(!inserted) storage::merge(it->second, std::move(rec));
+            }
+        }
+    }
+
+    void open(const std::string& path) {
+        if(path.empty() || running) return;
+        basePath = path;
+        // Anything still here was replayed at boot, or belongs to a run that never booted.
+        auto leftover = listSegments(basePath);
+        nextIndex = leftover.empty() ? 1 : leftover.back().first + 1;
+        if(!openSegment()) return;
+        queued.clear();
+        queuedSeq = appendedSeq = releasedSeq = prunedSeq = 0;
+        running = true;
+        thread = std::thread(run);
+        logger->info("Journal: appending to {}", current.path.string());
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!running) return;
+            running = false;
+        }
+        wake.notify_all();
+        thread.join();
+        if(fd >= 0) ::close(fd);
+        fd = -1;
+        closedSegments.push_back(current);
+        if(releasedSeq < appendedSeq) {
+            logger->warn("Journal: {} batches were not committed to the database; they will be replayed at boot.",
+                         appendedSeq - releasedSeq);
+            closedSegments.clear();
+            return;
+        }
+        prune(releasedSeq);
+        for(auto& s : closedSegments) std::filesystem::remove(s.path);
+        closedSegments.clear();
+    }
+
+    bool isOpen() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return running;
+    }
+
+    std::string encode(const std::vector<ObjectRecord>& batch) {
+        serial::Writer w;
+        w.varint(batch.size());
+        for(auto& rec : batch) {
+            w.key(rec.module);
+            w.svarint(rec.id);
+            w.svarint(rec.generation);
+            w.u8((rec.full ? Full : 0) | (rec.deleted ? Deleted : 0));
+            if(rec.full) {
+                w.str(rec.data);
+            } else if(!rec.deleted) {
+                w.varint(rec.fields.size());
+                for(auto& f : rec.fields) {
+                    w.varint(f.field);
+                    w.key(f.category);
+                    w.str(f.name);
+                    w.u8(f.value ? 1 : 0);
+                    if(f.value) w.str(*f.value);
+                }
+            }
+        }
+        return w.finish(serial::Kind::JournalBatch, formatVersion);
+    }
+
+    void append(uint64_t seq, std::string payload) {
+        FrameHeader header{static_cast<uint32_t>(payload.size()), frameCrc(seq, payload), seq};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!running) return;
+            queued.append(reinterpret_cast<const char*>(&header), sizeof(header));
+            queued.append(payload);
+            queuedSeq = std::max(queuedSeq, seq);
+            appendedSeq = std::max(appendedSeq, seq);
+        }
+        wake.notify_one();
+    }
+
+    void release(uint64_t seq) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(seq <= releasedSeq) return;
+            releasedSeq = seq;
+        }
+        wake.notify_one();
+    }
+
+    size_t replay(const std::string& path, storage::Store& store) {
+        if(path.empty()) return 0;
+        auto segments = listSegments(path);
+        if(segments.empty()) return 0;
+
+        std::map<std::pair<std::string, int64_t>, ObjectRecord> merged;
+        size_t frames = 0;
+        for(auto& [index, segment] : segments) {
+            std::ifstream in(segment, std::ios::binary);
+            std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            size_t pos = 0;
+            while(pos + sizeof(FrameHeader) <= data.size()) {
+                FrameHeader header;
+                std::memcpy(&header, data.data() + pos, sizeof(header));
+                auto start = pos + sizeof(header);
+                if(start + header.length > data.size()) break;
+                std::string_view payload(data.data() + start, header.length);
+                if(frameCrc(header.seq, payload) != header.crc) break;
+                decode(payload, merged);
+                frames++;
+                pos = start + header.length;
+            }
+            if(pos != data.size()) {
+                logger->warn("Journal: {} ends in a torn frame after {} bytes; the rest is discarded.", segment.string(), pos);
+            }
+        }
+
+        std::vector<ObjectRecord> records;
+        records.reserve(merged.size());
+        for(auto& [key, r] : merged) records.push_back(std::move(r));
+        store.saveObjects(records);
+        for(auto& [index, segment] : segments) std::filesystem::remove(segment);
+        logger->info("Journal: replayed {} frames ({} objects) from {} segments.", frames, records.size(), segments.size());
+        return records.size();
+    }
+}
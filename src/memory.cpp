@@ -0,0 +1,97 @@
+#include "kai/memory.h"
+#include "kai/structs.h"
+#include "kai/config.h"
+
+namespace memory {
+
+    void* ModuleResource::Upstream::do_allocate(size_t bytes, size_t alignment) {
+        auto p = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        reserved.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+        return p;
+    }
+
+    void ModuleResource::Upstream::do_deallocate(void* p, size_t bytes, size_t alignment) {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        reserved.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    }
+
+    bool ModuleResource::Upstream::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+    ModuleResource::ModuleResource(std::string name) : m_name(std::move(name)), m_pool(&m_upstream) {}
+
+    ModuleResource::~ModuleResource() = default;
+
+    void* ModuleResource::do_allocate(size_t bytes, size_t alignment) {
+        auto p = m_pool.allocate(bytes, alignment);
+        auto now = m_bytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) + static_cast<int64_t>(bytes);
+        m_allocations.fetch_add(1, std::memory_order_relaxed);
+        m_totalAllocations.fetch_add(1, std::memory_order_relaxed);
+        auto peak = m_peak.load(std::memory_order_relaxed);
+        while(now > peak && !m_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+
+        auto cap = limit();
+        if(cap > 0 && now > cap && !m_warned.exchange(true, std::memory_order_relaxed)) {
+            logger->warn("Memory: module {} went over its limit of {} bytes ({} in use).", m_name, cap, now);
+        }
+        return p;
+    }
+
+    void ModuleResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+        m_pool.deallocate(p, bytes, alignment);
+        auto now = m_bytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed) - static_cast<int64_t>(bytes);
+        m_allocations.fetch_sub(1, std::memory_order_relaxed);
+        // Warn again the next time it crosses, but not while it hovers around the limit.
+        auto cap = limit();
+        if(cap > 0 && now < cap - cap / 10) m_warned.store(false, std::memory_order_relaxed);
+    }
+
+    bool ModuleResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+    Stats ModuleResource::stats() const {
+        Stats s;
+        s.bytes = m_bytes.load(std::memory_order_relaxed);
+        s.peakBytes = m_peak.load(std::memory_order_relaxed);
+        s.reservedBytes = m_upstream.reserved.load(std::memory_order_relaxed);
+        s.allocations = m_allocations.load(std::memory_order_relaxed);
+        s.totalAllocations = m_totalAllocations.load(std::memory_order_relaxed);
+        s.limit = limit();
+        return s;
+    }
+
+    void ModuleResource::setLimit(int64_t bytes) {
+        m_limit.store(bytes, std::memory_order_relaxed);
+        m_warned.store(false, std::memory_order_relaxed);
+    }
+
+    int64_t ModuleResource::limit() const {
+        auto l = m_limit.load(std::memory_order_relaxed);
+        return l < 0 ? std::max<int64_t>(config::moduleMemoryLimit, 0) : l;
+    }
+
+    bool ModuleResource::overLimit() const {
+        auto cap = limit();
+        return cap > 0 && bytes() > cap;
+    }
+
+    nlohmann::json snapshot() {
+        nlohmann::json j = nlohmann::json::array();
+        for(auto& [name, module] : gameModules) {
+            auto s = module->getMemory().stats();
+            nlohmann::json m;
+            m["module"] = name;
+            m["objects"] = module->getGameObjects().size();
+            m["bytes"] = s.bytes;
+            m["peak_bytes"] = s.peakBytes;
+            m["reserved_bytes"] = s.reservedBytes;
+            m["allocations"] = s.allocations;
+            m["total_allocations"] = s.totalAllocations;
+            m["limit"] = s.limit;
+            j.push_back(m);
+        }
+        return j;
+    }
+}
@@ -2,6 +2,9 @@
 #include <regex>
 
 #include "kai/config.h"
+#include "kai/memory.h"
+#include "kai/profiler.h"
+#include "kai/replay.h"
 #include <boost/asio/experimental/awaitable_operators.hpp>
 #include <boost/beast/core/buffers_to_string.hpp>
 
@@ -61,7 +64,7 @@ namespace net {
         is_stopped = true;
     }
 
-    awaitable<void> Link::createUpdateClient(const nlohmann::json &j) {
+    static awaitable<void> createUpdateClient(const nlohmann::json &j) {
         auto id = j["id"].get<int64_t>();
         const auto& capabilities = j["capabilities"];
 
@@ -88,6 +91,60 @@ namespace net {
         co_return;
     }
 
+    awaitable<void> routeLinkMessage(nlohmann::json &j) {
+        // Access the "kind" field in the JSON object
+        std::string kind = j["kind"];
+
+        if (kind == "client_list") {
+            // This message is sent by Thermite when the game establishes a fresh connection with it.
+            // It should be the first thing a Link sees.
+            //logger->info("Link: Received client_list message");
+            // Get the "data" object
+            auto &data = j["data"];
+
+            // Iterate over the contents of the "data" object
+            for (const auto &entry : data) {
+                co_await createUpdateClient(entry);
+            }
+
+        } else if (kind == "client_ready") {
+            // This message is sent by Thermite when a new client has connected.
+            auto &data = j["protocol"];
+            co_await createUpdateClient(data);
+
+        } else {
+            // Extract the "id" field from the JSON object
+            int64_t id = j["id"];
+
+            // Look up the specific ClientConnection in the std::map
+            auto it = connections.find(id);
+            if(it == connections.end()) {
+                logger->info("Link: Received message for unknown client: {}", id);
+                co_return;
+            }
+
+            // Found the client connection
+            auto &client_connection = it->second;
+
+            if (kind == "client_capabilities") {
+                auto &capabilities = j["capabilities"];
+                client_connection->capabilities.deserialize(capabilities);
+
+            } else if (kind == "client_data") {
+                try {
+                    co_await client_connection->fromLink.async_send(boost::system::error_code{}, j, boost::asio::use_awaitable);
+                } catch (const boost::system::system_error &e) {
+                    // Handle exceptions (e.g., WebSocket close or error)
+                }
+
+            } else if (kind == "client_disconnected") {
+                logger->info("Link: Received client_disconnected message for client: {}", id);
+                deadConnections[id] = DisconnectReason::ConnectionClosed;
+            }
+        }
+        co_return;
+    }
+
     awaitable<void> Link::runReader() {
         while (!is_stopped) {
             try {
@@ -98,61 +155,10 @@ namespace net {
                 // Deserialize the JSON string
                 auto ws_str = boost::beast::buffers_to_string(buffer.data());
                 //std::cout << "Received: " << ws_str << std::endl;
+                if(recorder) recorder->record(ws_str);
                 auto j = nlohmann::json::parse(ws_str);
 
-
-                // Access the "kind" field in the JSON object
-                std::string kind = j["kind"];
-
-                // Implement your routing logic here
-
-                if (kind == "client_list") {
-                    // This message is sent by Thermite when the game establishes a fresh connection with it.
-                    // It should be the first thing a Link sees.
-                    //logger->info("Link: Received client_list message");
-                    // Get the "data" object
-                    auto &data = j["data"];
-
-                    // Iterate over the contents of the "data" object
-                    for (const auto &entry : data) {
-                        co_await createUpdateClient(entry);
-                    }
-
-                } else if (kind == "client_ready") {
-                    // This message is sent by Thermite when a new client has connected.
-                    auto &data = j["protocol"];
-                    co_await createUpdateClient(data);
-
-                } else {
-                    // Extract the "id" field from the JSON object
-                    int64_t id = j["id"];
-
-                    // Look up the specific ClientConnection in the std::map
-                    auto it = connections.find(id);
-                    if(it == connections.end()) {
-                        logger->info("Link: Received message for unknown client: {}", id);
-                        continue;
-                    }
-
-                    // Found the client connection
-                    auto &client_connection = it->second;
-
-                    if (kind == "client_capabilities") {
-                        auto &capabilities = j["capabilities"];
-                        client_connection->capabilities.deserialize(capabilities);
-
-                    } else if (kind == "client_data") {
-                        try {
-                            co_await client_connection->fromLink.async_send(boost::system::error_code{}, j, boost::asio::use_awaitable);
-                        } catch (const boost::system::system_error &e) {
-                            // Handle exceptions (e.g., WebSocket close or error)
-                        }
-
-                    } else if (kind == "client_disconnected") {
-                        logger->info("Link: Received client_disconnected message for client: {}", id);
-                        deadConnections[id] = DisconnectReason::ConnectionClosed;
-                    }
-                }
+                co_await routeLinkMessage(j);
             } catch (const boost::system::system_error &e) {
                 logger->error("Link RunReader flopped at: {}", e.what());
                 break;
@@ -375,6 +381,18 @@ namespace net {
                     if(parser) parser->parse(t);
                 }
             }
+        } else if(m.cmd == "profiler" && adminLevel > 0) {
+            // Admin tooling asks for the tick profiler's current percentiles.
+            Message reply;
+            reply.cmd = "profiler";
+            reply.kwargs = profiler::snapshot();
+            sendMessage(reply);
+        } else if(m.cmd == "memory" && adminLevel > 0) {
+            // ...and for every module's allocation statistics.
+            Message reply;
+            reply.cmd = "memory";
+            reply.kwargs["modules"] = memory::snapshot();
+            sendMessage(reply);
         } else {
             if(parser) parser->handleMessage(m);
         }
@@ -0,0 +1,198 @@
+#include "kai/persistence.h"
+#include "kai/config.h"
+#include "kai/db.h"
+#include "kai/snapshot.h"
+#include "kai/journal.h"
+#include <thread>
+#include <condition_variable>
+
+namespace persistence {
+
+    namespace {
+        std::thread writer;
+        std::mutex mutex;
+        std::condition_variable wake, committed;
+        bool running{false};
+
+        // Everything of each object that has not been written yet. A later full snapshot replaces
+        // what was pending, later deltas are appended, so a busy object costs one row per batch.
+        std::map<std::pair<std::string, int64_t>, ObjectRecord> pending;
+        // the objects of the batch being written right now.
+        std::set<std::pair<std::string, int64_t>> inFlight;
+        uint64_t submittedSeq{0}, committedSeq{0}, flushTarget{0};
+        // failed batch writes since start, so a flush can tell the writer is stuck.
+        uint64_t failedWrites{0};
+        // how many failed writes a flush sits through before giving up.
+        constexpr uint64_t flushAttempts = 3;
+
+        std::unique_ptr<storage::Store> store;
+        storage::Checkpointer checkpointer;
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto lastWrite = std::chrono::steady_clock::now();
+            while(true) {
+                wake.wait_for(lock, config::persistenceInterval, [&] {
+                    return !running || flushTarget > committedSeq || pending.size() >= config::persistenceBatchSize;
+                });
+                bool due = std::chrono::steady_clock::now() - lastWrite >= config::persistenceInterval;
+                if(pending.empty()) {
+                    committedSeq = submittedSeq;
+                    journal::release(committedSeq);
+                    committed.notify_all();
+                    if(!running) break;
+                    continue;
+                }
+                if(!due && running && flushTarget <= committedSeq && pending.size() < config::persistenceBatchSize) continue;
+
+                std::vector<ObjectRecord> batch;
+                batch.reserve(pending.size());
+                for(auto& [key, r] : pending) {
+                    inFlight.insert(key);
+                    batch.push_back(std::move(r));
+                }
+                pending.clear();
+                auto seq = submittedSeq;
+
+                lock.unlock();
+                bool ok = true;
+                try {
+                    store->saveObjects(batch);
+                } catch(const std::exception& e) {
+                    logger->error("Persistence: failed to write {} objects: {}", batch.size(), e.what());
+                    ok = false;
+                }
+                lastWrite = std::chrono::steady_clock::now();
+                lock.lock();
+                inFlight.clear();
+
+                if(!ok) {
+                    failedWrites++;
+                    committed.notify_all();
+                    // Put them back underneath anything newer that arrived meanwhile, and retry.
+                    for(auto& r : batch) {
+                        auto [it, inserted] = pending.try_emplace({r.module, r.id}, std::move(r));
+                        if(inserted) continue;
+                        auto newer = std::move(it->second);
+                        it->second = std::move(r);
+                        storage::merge(it->second, std::move(newer));
+                    }
+                    if(!running) break;
+                    wake.wait_for(lock, config::persistenceInterval, [&] { return !running; });
+                    continue;
+                }
+                committedSeq = seq;
+                journal::release(committedSeq);
+                committed.notify_all();
+            }
+        }
+    }
+
+    void start() {
+        if(running) return;
+        auto path = fmt::format("{}.sqlite3", config::assetDbName);
+        store = std::make_unique<storage::Store>(path);
+        store->createSchema();
+        // From the first write on, the database is ahead of any snapshot written before.
+        snapshot::markStale(*store);
+        journal::open(config::journalFile);
+        running = true;
+        writer = std::thread(run);
+        checkpointer.start(path, config::walCheckpointInterval);
+        logger->info("Persistence writer started.");
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!running) return;
+            running = false;
+        }
+        wake.notify_all();
+        writer.join();
+        committed.notify_all();
+        if(!pending.empty()) {
+            logger->error("Persistence: {} objects could not be saved at shutdown.", pending.size());
+        }
+        journal::close();
+        checkpointer.stop();
+        store.reset();
+        logger->info("Persistence writer stopped.");
+    }
+
+    void submit(std::vector<ObjectRecord> batch) {
+        if(batch.empty()) return;
+        std::string frame;
+        if(journal::isOpen()) frame = journal::encode(batch);
+        uint64_t seq;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(auto& r : batch) {
+                auto [it, inserted] = pending.try_emplace({r.module, r.id}, std::move(r));
+                if(!inserted) storage::merge(it->second, std::move(r));
+            }
+            seq = ++submittedSeq;
+        }
+        if(!frame.empty()) journal::append(seq, std::move(frame));
+        wake.notify_one();
+    }
+
+    void processDirty() {
+        std::vector<ObjectRecord> batch;
+        for(auto& [name, module] : gameModules) {
+            for(auto id : module->takeDirty()) {
+                ObjectRecord r;
+                r.module = name;
+                r.id = id;
+                // Never through getGameObject(): in a paged module that would bring a removed
+                // object back as a shell of its saved row.
+                if(auto obj = module->findInMemory(id)) {
+                    r.generation = obj->getGeneration();
+                    r.full = obj->needsFullSave();
+                    if(r.full) {
+                        r.data = obj->serializeBinary();
+                        obj->noteEncodedSize(r.data.size());
+                        obj->clearChanges();
+                    } else {
+                        r.fields = obj->takeChanges();
+                        if(r.fields.empty()) continue;
+                    }
+                } else {
+                    r.deleted = true;
+                }
+                snapshot::invalidate(name, id);
+                batch.push_back(std::move(r));
+            }
+        }
+        submit(std::move(batch));
+    }
+
+    bool isSettled(const std::string& module, int64_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto key = std::make_pair(module, id);
+        return !pending.contains(key) && !inFlight.contains(key);
+    }
+
+    bool flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(!running) return committedSeq >= submittedSeq;
+        auto target = submittedSeq;
+        auto failuresBefore = failedWrites;
+        flushTarget = std::max(flushTarget, target);
+        wake.notify_one();
+        committed.wait(lock, [&] {
+            return committedSeq >= target || !running || failedWrites >= failuresBefore + flushAttempts;
+        });
+        if(committedSeq >= target) return true;
+        // The writer keeps the batch and goes on retrying; the caller just stops waiting for it.
+        logger->error("Persistence: flush gave up after {} failed writes; {} objects are still pending.",
+                      failedWrites - failuresBefore, pending.size() + inFlight.size());
+        return false;
+    }
+
+    bool saveAll() {
+        for(auto& [name, module] : gameModules) module->saveAll();
+        processDirty();
+        return flush();
+    }
+}
@@ -1,11 +1,32 @@
 #include "kai/structs.h"
+#include "kai/interest.h"
+
+PlayView::PlayView(std::shared_ptr<GameObject> character) : character(character) {
+    if(character) interest::observe(*this, *character);
+}
+
+PlayView::~PlayView() {
+    interest::forget(*this);
+}
 
 bool PlayView::isActive() {
     return true;
 }
 
 void PlayView::update(double deltaTime) {
+    if(raw_input_queue) handle_input();
+}
+
+GameModule* PlayView::getZone() {
+    auto c = character.lock();
+    if(!c) return nullptr;
+    if(auto room = c->getParent()) return room->getModule();
+    return c->getModule();
+}
 
+GameModule* PlayView::getCharacterModule() {
+    auto c = character.lock();
+    return c ? c->getModule() : nullptr;
 }
 
 void PlayView::addParser(std::shared_ptr<PlayViewParser> parser) {
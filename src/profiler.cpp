@@ -0,0 +1,307 @@
+#include "kai/profiler.h"
+#include "kai/config.h"
+#include <bit>
+#include <fstream>
+
+namespace profiler {
+
+    namespace {
+        struct PhaseRegistry {
+            std::mutex mutex;
+            std::array<std::string, maxPhases> names;
+            std::array<PhaseKind, maxPhases> kinds{};
+            std::atomic<PhaseId> count{0};
+        };
+
+        PhaseRegistry& registry() {
+            static PhaseRegistry r;
+            return r;
+        }
+
+        struct Sample {
+            int64_t start;
+            int64_t duration;
+            PhaseId phase;
+        };
+
+        // Single-producer/single-consumer ring. The owning thread pushes, endTick() drains.
+        constexpr uint32_t bufferSize = 8192;
+        struct ThreadBuffer {
+            std::array<Sample, bufferSize> ring;
+            std::atomic<uint32_t> head{0}, tail{0};
+            std::atomic<uint64_t> dropped{0};
+            uint32_t tid{0};
+        };
+
+        // Buffers are never freed; the executor threads live as long as the process does.
+        std::mutex buffersMutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+        ThreadBuffer& localBuffer() {
+            thread_local ThreadBuffer* buf = [] {
+                std::lock_guard<std::mutex> lock(buffersMutex);
+                auto& b = buffers.emplace_back(std::make_unique<ThreadBuffer>());
+                b->tid = buffers.size();
+                return b.get();
+            }();
+            return *buf;
+        }
+
+        // Everything below is only touched by the game strand.
+        struct PhaseStats {
+            RollingHistogram window;
+            int64_t lastTick{0};
+        };
+        std::array<std::unique_ptr<PhaseStats>, maxPhases> stats;
+        std::vector<ThreadBuffer*> drainList;
+        uint64_t tickCount{0};
+        int64_t tickStart{0};
+
+        std::ofstream traceFile;
+        int64_t traceEpoch{0};
+        std::string traceBuffer;
+
+        const PhaseId tickPhase = registerPhase("tick");
+
+        void writeTrace(const Sample& s, uint32_t tid) {
+            fmt::format_to(std::back_inserter(traceBuffer),
+                           ",\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{}}}",
+                           phaseName(s.phase), phaseKind(s.phase) == PhaseKind::System ? "system" : "phase",
+                           (s.start - traceEpoch) / 1000.0, s.duration / 1000.0, tid);
+        }
+
+        void collect() {
+            for(auto& s : stats) {
+                if(s) s->lastTick = 0;
+            }
+            drainList.clear();
+            {
+                std::lock_guard<std::mutex> lock(buffersMutex);
+                for(auto& b : buffers) drainList.push_back(b.get());
+            }
+
+            auto timestamp = now();
+            for(auto b : drainList) {
+                auto head = b->head.load(std::memory_order_acquire);
+                for(auto t = b->tail.load(std::memory_order_relaxed); t != head; ++t) {
+                    auto& s = b->ring[t & (bufferSize - 1)];
+                    if(s.phase >= maxPhases) continue;
+                    auto& st = stats[s.phase];
+                    if(!st) st = std::make_unique<PhaseStats>();
+                    st->window.record(s.duration, timestamp);
+                    st->lastTick += s.duration;
+                    if(traceFile.is_open()) writeTrace(s, b->tid);
+                }
+                b->tail.store(head, std::memory_order_release);
+            }
+
+            if(!traceBuffer.empty()) {
+                traceFile << traceBuffer;
+                traceBuffer.clear();
+            }
+        }
+    }
+
+    PhaseId registerPhase(const std::string& name, PhaseKind kind) {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto count = r.count.load();
+        for(PhaseId i = 0; i < count; i++) {
+            if(r.names[i] == name && r.kinds[i] == kind) return i;
+        }
+        if(count == maxPhases) {
+            throw std::runtime_error(fmt::format("Too many profiler phases registered, cannot add '{}'", name));
+        }
+        r.names[count] = name;
+        r.kinds[count] = kind;
+        r.count.store(count + 1, std::memory_order_release);
+        return count;
+    }
+
+    const std::string& phaseName(PhaseId id) {
+        return registry().names.at(id);
+    }
+
+    PhaseKind phaseKind(PhaseId id) {
+        return registry().kinds.at(id);
+    }
+
+    int Histogram::bucketFor(int64_t value) {
+        if(value < subBuckets) return value < 0 ? 0 : static_cast<int>(value);
+        int exponent = std::bit_width(static_cast<uint64_t>(value)) - 1;
+        if(exponent > maxExponent) return bucketCount - 1;
+        auto sub = (value >> (exponent - subBucketBits)) & (subBuckets - 1);
+        return (exponent - subBucketBits + 1) * subBuckets + static_cast<int>(sub);
+    }
+
+    int64_t Histogram::valueFor(int bucket) {
+        if(bucket < subBuckets) return bucket;
+        int exponent = bucket / subBuckets + subBucketBits - 1;
+        int64_t sub = bucket % subBuckets;
+        int64_t width = int64_t(1) << (exponent - subBucketBits);
+        return ((subBuckets + sub) << (exponent - subBucketBits)) + width / 2;
+    }
+
+    void Histogram::record(int64_t value) {
+        buckets[bucketFor(value)]++;
+        total++;
+        if(value > maxValue) maxValue = value;
+    }
+
+    void Histogram::merge(const Histogram& other) {
+        for(int i = 0; i < bucketCount; i++) buckets[i] += other.buckets[i];
+        total += other.total;
+        maxValue = std::max(maxValue, other.maxValue);
+    }
+
+    void Histogram::reset() {
+        buckets.fill(0);
+        total = 0;
+        maxValue = 0;
+    }
+
+    int64_t Histogram::percentile(double p) const {
+        if(!total) return 0;
+        auto target = static_cast<uint64_t>(std::ceil(p / 100.0 * total));
+        if(target < 1) target = 1;
+        uint64_t seen = 0;
+        for(int i = 0; i < bucketCount; i++) {
+            seen += buckets[i];
+            if(seen >= target) return std::min(valueFor(i), maxValue);
+        }
+        return maxValue;
+    }
+
+    void RollingHistogram::rotate(int64_t timestamp) {
+        auto period = std::chrono::duration_cast<std::chrono::nanoseconds>(config::profilerWindow).count() / slotCount;
+        if(!slotStart || period <= 0) {
+            slotStart = timestamp;
+            return;
+        }
+        if(timestamp - slotStart >= period * slotCount) {
+            for(auto& s : slots) s.reset();
+            slotStart = timestamp;
+            return;
+        }
+        while(timestamp - slotStart >= period) {
+            current = (current + 1) % slotCount;
+            slots[current].reset();
+            slotStart += period;
+        }
+    }
+
+    void RollingHistogram::record(int64_t value, int64_t timestamp) {
+        rotate(timestamp);
+        slots[current].record(value);
+    }
+
+    Histogram RollingHistogram::merged() const {
+        Histogram h;
+        for(auto& s : slots) h.merge(s);
+        return h;
+    }
+
+    Marker marker;
+
+    Scope::Scope(PhaseId phase) : phase(phase), start(now()) {
+        auto& slot = phaseKind(phase) == PhaseKind::System ? marker.system : marker.phase;
+        previous = slot.exchange(phase, std::memory_order_relaxed);
+        marker.phaseStart.store(start, std::memory_order_relaxed);
+        marker.thread.store(pthread_self(), std::memory_order_release);
+    }
+
+    Scope::~Scope() {
+        auto end = now();
+        auto& slot = phaseKind(phase) == PhaseKind::System ? marker.system : marker.phase;
+        slot.store(previous, std::memory_order_relaxed);
+        marker.phaseStart.store(end, std::memory_order_relaxed);
+        record(phase, start, end - start);
+    }
+
+    void record(PhaseId phase, int64_t start, int64_t duration) {
+        auto& b = localBuffer();
+        auto head = b.head.load(std::memory_order_relaxed);
+        if(head - b.tail.load(std::memory_order_acquire) >= bufferSize) {
+            b.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        b.ring[head & (bufferSize - 1)] = Sample{start, duration, phase};
+        b.head.store(head + 1, std::memory_order_release);
+    }
+
+    void beginTick() {
+        tickStart = now();
+        marker.thread.store(pthread_self(), std::memory_order_relaxed);
+        marker.tick.store(tickCount, std::memory_order_relaxed);
+        marker.tickStart.store(tickStart, std::memory_order_release);
+    }
+
+    void endTick() {
+        record(tickPhase, tickStart, now() - tickStart);
+        marker.tickStart.store(0, std::memory_order_release);
+        tickCount++;
+        collect();
+    }
+
+    void logLastTick() {
+        std::vector<std::pair<int64_t, PhaseId>> recorded;
+        for(PhaseId i = 0; i < maxPhases; i++) {
+            if(stats[i] && stats[i]->lastTick) recorded.emplace_back(stats[i]->lastTick, i);
+        }
+        std::sort(recorded.begin(), recorded.end(), std::greater<>());
+        for(auto& [duration, id] : recorded) {
+            logger->warn("Timing {}: {}", phaseName(id), duration / 1e9);
+        }
+    }
+
+    nlohmann::json snapshot() {
+        nlohmann::json j;
+        j["ticks"] = tickCount;
+        j["window_seconds"] = config::profilerWindow.count();
+
+        uint64_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            for(auto& b : buffers) dropped += b->dropped.load(std::memory_order_relaxed);
+        }
+        j["dropped_samples"] = dropped;
+
+        auto& phases = j["phases"] = nlohmann::json::array();
+        for(PhaseId i = 0; i < maxPhases; i++) {
+            if(!stats[i]) continue;
+            auto h = stats[i]->window.merged();
+            if(!h.count()) continue;
+            nlohmann::json p;
+            p["name"] = phaseName(i);
+            p["kind"] = phaseKind(i) == PhaseKind::System ? "system" : "phase";
+            p["count"] = h.count();
+            p["p50_ms"] = h.percentile(50.0) / 1e6;
+            p["p99_ms"] = h.percentile(99.0) / 1e6;
+            p["max_ms"] = h.max() / 1e6;
+            p["last_ms"] = stats[i]->lastTick / 1e6;
+            phases.push_back(p);
+        }
+        return j;
+    }
+
+    void openTrace(const std::string& path) {
+        if(path.empty()) return;
+        traceFile.open(path, std::ios::out | std::ios::trunc);
+        if(!traceFile.is_open()) {
+            logger->error("Could not open profiler trace file {}", path);
+            return;
+        }
+        traceEpoch = now();
+        // The JSON Array Format does not require the closing bracket, so a crashed server still
+        // leaves a loadable trace behind.
+        traceFile << "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"kai\"}}";
+        logger->info("Writing profiler trace to {}", path);
+    }
+
+    void closeTrace() {
+        if(!traceFile.is_open()) return;
+        traceFile << traceBuffer << "\n]\n";
+        traceBuffer.clear();
+        traceFile.close();
+    }
+}
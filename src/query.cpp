@@ -0,0 +1,329 @@
+#include "kai/query.h"
+#include "lua.h"
+#include "lualib.h"
+
+namespace query {
+
+    namespace {
+        // Equality only: the objects holding each value, with every object's position remembered
+        // so that moving it to another value is O(1).
+        template<typename V>
+        class HashIndex : public Index {
+        public:
+            using Index::Index;
+
+            void assign(const ObjectHandle& handle, const Value* value) override {
+                if(!value || !std::holds_alternative<V>(*value)) {
+                    erase(handle);
+                    return;
+                }
+                auto& v = std::get<V>(*value);
+                if(auto it = current.find(handle.slot.index); it != current.end()) {
+                    if(it->second.value == v) {
+                        buckets[v][it->second.position] = handle;
+                        return;
+                    }
+                    unlink(it->second);
+                    current.erase(it);
+                }
+                auto& bucket = buckets[v];
+                current.emplace(handle.slot.index, Entry{v, static_cast<uint32_t>(bucket.size())});
+                bucket.push_back(handle);
+            }
+
+            void erase(const ObjectHandle& handle) override {
+                auto it = current.find(handle.slot.index);
+                if(it == current.end()) return;
+                unlink(it->second);
+                current.erase(it);
+            }
+
+            void equal(const Value& value, std::vector<ObjectHandle>& out) const override {
+                if(!std::holds_alternative<V>(value)) return;
+                auto it = buckets.find(std::get<V>(value));
+                if(it != buckets.end()) out.insert(out.end(), it->second.begin(), it->second.end());
+            }
+
+            bool range(const std::optional<Value>&, const std::optional<Value>&, std::vector<ObjectHandle>&) const override {
+                return false;
+            }
+
+            [[nodiscard]] size_t size() const override { return current.size(); }
+
+        private:
+            struct Entry {
+                V value;
+                uint32_t position;
+            };
+
+            void unlink(const Entry& entry) {
+                auto it = buckets.find(entry.value);
+                auto& bucket = it->second;
+                if(entry.position != bucket.size() - 1) {
+                    bucket[entry.position] = bucket.back();
+                    current[bucket[entry.position].slot.index].position = entry.position;
+                }
+                bucket.pop_back();
+                if(bucket.empty()) buckets.erase(it);
+            }
+
+            std::unordered_map<V, std::vector<ObjectHandle>> buckets;
+            // by object slot.
+            std::unordered_map<uint32_t, Entry> current;
+        };
+
+        // Equality and ranges, in value order.
+        template<typename V>
+        class OrderedIndex : public Index {
+        public:
+            using Index::Index;
+
+            void assign(const ObjectHandle& handle, const Value* value) override {
+                if(!value || !std::holds_alternative<V>(*value)) {
+                    erase(handle);
+                    return;
+                }
+                auto& v = std::get<V>(*value);
+                if(auto it = current.find(handle.slot.index); it != current.end()) {
+                    if(it->second->first == v) {
+                        it->second->second = handle;
+                        return;
+                    }
+                    tree.erase(it->second);
+                    it->second = tree.emplace(v, handle);
+                    return;
+                }
+                current.emplace(handle.slot.index, tree.emplace(v, handle));
+            }
+
+            void erase(const ObjectHandle& handle) override {
+                auto it = current.find(handle.slot.index);
+                if(it == current.end()) return;
+                tree.erase(it->second);
+                current.erase(it);
+            }
+
+            void equal(const Value& value, std::vector<ObjectHandle>& out) const override {
+                if(!std::holds_alternative<V>(value)) return;
+                auto [first, last] = tree.equal_range(std::get<V>(value));
+                for(; first != last; ++first) out.push_back(first->second);
+            }
+
+            bool range(const std::optional<Value>& low, const std::optional<Value>& high, std::vector<ObjectHandle>& out) const override {
+                if((low && !std::holds_alternative<V>(*low)) || (high && !std::holds_alternative<V>(*high))) return true;
+                if(low && high && std::get<V>(*high) < std::get<V>(*low)) return true;
+                auto first = low ? tree.lower_bound(std::get<V>(*low)) : tree.begin();
+                auto last = high ? tree.upper_bound(std::get<V>(*high)) : tree.end();
+                for(; first != last; ++first) out.push_back(first->second);
+                return true;
+            }
+
+            [[nodiscard]] size_t size() const override { return current.size(); }
+
+        private:
+            using Tree = std::multimap<V, ObjectHandle>;
+            Tree tree;
+            // by object slot.
+            std::unordered_map<uint32_t, typename Tree::iterator> current;
+        };
+
+        template<typename V>
+        std::unique_ptr<Index> makeTyped(Attribute attribute, IndexKind kind) {
+            if(kind == IndexKind::Ordered) return std::make_unique<OrderedIndex<V>>(attribute, kind);
+            return std::make_unique<HashIndex<V>>(attribute, kind);
+        }
+
+        bool inRange(const Value& v, const std::optional<Value>& low, const std::optional<Value>& high) {
+            if(low && (low->index() != v.index() || v < *low)) return false;
+            if(high && (high->index() != v.index() || *high < v)) return false;
+            return true;
+        }
+
+        template<typename F>
+        std::vector<ObjectHandle> scan(GameModule& module, const Attribute& attribute, F&& matches) {
+            std::vector<ObjectHandle> out;
+            for(auto& [id, obj] : module.getGameObjects()) {
+                if(!obj->isResident()) continue;
+                if(auto v = valueOf(*obj, attribute); v && matches(*v)) out.push_back(obj->getHandle());
+            }
+            return out;
+        }
+    }
+
+    Attribute::Attribute(ObjectField field, const std::string& category, const std::string& name)
+        : field(field), category(symbols::intern(category)), name(symbols::intern(name)) {}
+
+    std::unique_ptr<Index> makeIndex(Attribute attribute, IndexKind kind) {
+        switch(attribute.field) {
+            case ObjectField::Stats:
+                return makeTyped<double>(attribute, kind);
+            case ObjectField::Strings:
+                return makeTyped<std::string>(attribute, kind);
+            default:
+                throw std::runtime_error(fmt::format("Cannot index object field {}", static_cast<uint32_t>(attribute.field)));
+        }
+    }
+
+    namespace {
+        std::optional<ObjectField> fieldNamed(std::string_view name) {
+            if(name == "stats") return ObjectField::Stats;
+            if(name == "strings") return ObjectField::Strings;
+            return std::nullopt;
+        }
+
+        std::optional<IndexKind> kindNamed(std::string_view name) {
+            if(name == "hash") return IndexKind::Hash;
+            if(name == "ordered") return IndexKind::Ordered;
+            return std::nullopt;
+        }
+    }
+
+    size_t createIndexes(GameModule& module, const nlohmann::json& definitions) {
+        size_t created = 0;
+        for(auto& d : definitions) {
+            auto field = d.is_object() ? fieldNamed(d.value("field", "")) : std::nullopt;
+            auto kind = d.is_object() ? kindNamed(d.value("kind", "hash")) : std::nullopt;
+            if(!field || !kind || !d.contains("category") || !d.contains("name") || !d["category"].is_string() || !d["name"].is_string()) {
+                logger->warn("{}/indexes.json: not a valid index: {}", module.getName(), d.dump());
+                continue;
+            }
+            module.createIndex(Attribute(*field, d["category"].get<std::string>(), d["name"].get<std::string>()), *kind);
+            created++;
+        }
+        return created;
+    }
+
+    std::optional<Value> valueOf(const GameObject& obj, const Attribute& attribute) {
+        switch(attribute.field) {
+            case ObjectField::Stats:
+                if(auto v = obj.findStat(attribute.category, attribute.name)) return Value{*v};
+                break;
+            case ObjectField::Strings:
+                if(auto v = obj.findString(attribute.category, attribute.name)) return Value{*v};
+                break;
+            default:
+                break;
+        }
+        return std::nullopt;
+    }
+
+    std::vector<ObjectHandle> find(GameModule& module, const Attribute& attribute, const Value& value) {
+        if(auto index = module.findIndex(attribute)) {
+            std::vector<ObjectHandle> out;
+            index->equal(value, out);
+            return out;
+        }
+        return scan(module, attribute, [&](const Value& v) { return v == value; });
+    }
+
+    std::vector<ObjectHandle> range(GameModule& module, const Attribute& attribute,
+                                    const std::optional<Value>& low, const std::optional<Value>& high) {
+        if(auto index = module.findIndex(attribute, true)) {
+            std::vector<ObjectHandle> out;
+            index->range(low, high, out);
+            return out;
+        }
+        return scan(module, attribute, [&](const Value& v) { return inRange(v, low, high); });
+    }
+
+    namespace {
+        // Arguments 1-4 of both Luau functions: module, attribute kind, category, name.
+        std::vector<GameModule*> luaModules(lua_State *L) {
+            std::vector<GameModule*> modules;
+            if(lua_isnoneornil(L, 1)) {
+                for(auto& [name, module] : gameModules) modules.push_back(module.get());
+            } else if(auto it = gameModules.find(luaL_checkstring(L, 1)); it != gameModules.end()) {
+                modules.push_back(it->second.get());
+            }
+            return modules;
+        }
+
+        GameModule& luaModule(lua_State *L) {
+            std::string name = luaL_checkstring(L, 1);
+            auto it = gameModules.find(name);
+            if(it == gameModules.end()) luaL_error(L, "query: no module named '%s'", name.c_str());
+            return *it->second;
+        }
+
+        Attribute luaAttribute(lua_State *L) {
+            std::string kind = luaL_checkstring(L, 2);
+            auto field = fieldNamed(kind);
+            if(!field) luaL_error(L, "query: attributes are either 'stats' or 'strings', not '%s'", kind.c_str());
+            return Attribute(*field, luaL_checkstring(L, 3), luaL_checkstring(L, 4));
+        }
+
+        IndexKind luaKind(lua_State *L, int index) {
+            std::string name = luaL_optstring(L, index, "hash");
+            auto kind = kindNamed(name);
+            if(!kind) luaL_error(L, "query: indexes are either 'hash' or 'ordered', not '%s'", name.c_str());
+            return *kind;
+        }
+
+        std::optional<Value> luaValue(lua_State *L, int index, const Attribute& attribute) {
+            if(lua_isnoneornil(L, index)) return std::nullopt;
+            if(attribute.field == ObjectField::Stats) return Value{luaL_checknumber(L, index)};
+            return Value{std::string(luaL_checkstring(L, index))};
+        }
+
+        void pushResults(lua_State *L, GameModule& module, const std::vector<ObjectHandle>& handles, int& count) {
+            for(auto& h : handles) {
+                auto obj = module.resolve(h);
+                if(!obj) continue;
+                lua_createtable(L, 0, 3);
+                lua_pushstring(L, module.getName().c_str());
+                lua_setfield(L, -2, "module");
+                lua_pushnumber(L, static_cast<double>(obj->getID()));
+                lua_setfield(L, -2, "id");
+                lua_pushnumber(L, static_cast<double>(obj->getGeneration()));
+                lua_setfield(L, -2, "generation");
+                lua_rawseti(L, -2, ++count);
+            }
+        }
+
+        int luaFind(lua_State *L) {
+            auto attribute = luaAttribute(L);
+            auto value = luaValue(L, 5, attribute);
+            if(!value) luaL_error(L, "query.find: missing value");
+            lua_createtable(L, 0, 0);
+            int count = 0;
+            for(auto module : luaModules(L)) pushResults(L, *module, find(*module, attribute, *value), count);
+            return 1;
+        }
+
+        int luaRange(lua_State *L) {
+            auto attribute = luaAttribute(L);
+            auto low = luaValue(L, 5, attribute), high = luaValue(L, 6, attribute);
+            lua_createtable(L, 0, 0);
+            int count = 0;
+            for(auto module : luaModules(L)) pushResults(L, *module, range(*module, attribute, low, high), count);
+            return 1;
+        }
+
+        int luaCreateIndex(lua_State *L) {
+            auto& module = luaModule(L);
+            auto attribute = luaAttribute(L);
+            module.createIndex(attribute, luaKind(L, 5));
+            return 0;
+        }
+
+        int luaDropIndex(lua_State *L) {
+            auto& module = luaModule(L);
+            auto attribute = luaAttribute(L);
+            lua_pushboolean(L, module.dropIndex(attribute, luaKind(L, 5)));
+            return 1;
+        }
+    }
+
+    void registerLua(lua_State *L) {
+        lua_createtable(L, 0, 4);
+        lua_pushcfunction(L, luaFind, "find");
+        lua_setfield(L, -2, "find");
+        lua_pushcfunction(L, luaRange, "range");
+        lua_setfield(L, -2, "range");
+        lua_pushcfunction(L, luaCreateIndex, "createIndex");
+        lua_setfield(L, -2, "createIndex");
+        lua_pushcfunction(L, luaDropIndex, "dropIndex");
+        lua_setfield(L, -2, "dropIndex");
+        lua_setglobal(L, "query");
+    }
+}
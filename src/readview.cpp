@@ -0,0 +1,176 @@
+#include "kai/readview.h"
+#include <thread>
+
+namespace readview {
+
+    namespace {
+        // Epoch-based reclamation. Every reading thread owns a slot announcing the epoch it entered
+        // at; a retired view is freed once every announced epoch is past the one it was retired in.
+        constexpr uint64_t idle = UINT64_MAX;
+        constexpr size_t maxReaderThreads = 256;
+
+        struct alignas(64) ReaderSlot {
+            std::atomic<bool> taken{false};
+            std::atomic<uint64_t> epoch{idle};
+        };
+        std::array<ReaderSlot, maxReaderThreads> readerSlots;
+
+        struct ThreadSlot {
+            ReaderSlot* slot{nullptr};
+            int depth{0};
+
+            ~ThreadSlot() {
+                if(slot) slot->taken.store(false, std::memory_order_release);
+            }
+        };
+        thread_local ThreadSlot threadSlot;
+
+        std::atomic<bool> publishing{false};
+        std::atomic<uint64_t> globalEpoch{1};
+        std::atomic<const WorldView*> latest{nullptr};
+
+        // Everything below is only touched by the game thread.
+        std::vector<std::pair<uint64_t, const WorldView*>> retired;
+        uint64_t lastTick{0};
+
+        ReaderSlot& claimSlot() {
+            if(threadSlot.slot) return *threadSlot.slot;
+            for(auto& s : readerSlots) {
+                bool expected = false;
+                if(!s.taken.load(std::memory_order_relaxed) && s.taken.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                    threadSlot.slot = &s;
+                    return s;
+                }
+            }
+            throw std::runtime_error(fmt::format("More than {} threads are reading world views at once", maxReaderThreads));
+        }
+
+        void reclaim() {
+            auto oldest = idle;
+            for(auto& s : readerSlots) oldest = std::min(oldest, s.epoch.load(std::memory_order_seq_cst));
+            std::erase_if(retired, [&](auto& r) {
+                if(r.first >= oldest) return false;
+                delete r.second;
+                return true;
+            });
+        }
+
+        const std::shared_ptr<const ModuleView>* findModule(const WorldView* view, std::string_view name) {
+            if(!view) return nullptr;
+            auto it = std::lower_bound(view->modules.begin(), view->modules.end(), name,
+                                       [](auto& m, std::string_view n) { return m->name < n; });
+            return it != view->modules.end() && (*it)->name == name ? &*it : nullptr;
+        }
+
+        // Files obj's current state under id, copying the chunk on its first change this round.
+        void file(ModuleView& view, std::unordered_map<size_t, std::shared_ptr<Chunk>>& copied, int64_t id, const GameObject* obj) {
+            if(id < 0) return;
+            auto index = static_cast<size_t>(id) >> chunkBits;
+            if(index >= view.chunks.size()) view.chunks.resize(index + 1);
+            auto& chunk = copied[index];
+            if(!chunk) {
+                chunk = view.chunks[index] ? std::make_shared<Chunk>(*view.chunks[index]) : std::make_shared<Chunk>();
+                view.chunks[index] = chunk;
+            }
+            auto& slot = chunk->objects[id & ((1 << chunkBits) - 1)];
+            std::shared_ptr<const ObjectView> value;
+            // a shell that was not loaded again keeps what was published before.
+            if(obj) value = obj->isResident() ? obj->capture() : slot;
+            if(slot) view.objectCount--;
+            if(value) view.objectCount++;
+            slot = std::move(value);
+        }
+
+        std::shared_ptr<const ModuleView> buildModule(GameModule& module, const std::shared_ptr<const ModuleView>* previous) {
+            auto changes = module.takeViewChanges();
+            if(previous && changes.empty()) return *previous;
+
+            auto view = std::make_shared<ModuleView>();
+            view->name = module.getName();
+            std::unordered_map<size_t, std::shared_ptr<Chunk>> copied;
+            if(previous) {
+                view->chunks = (*previous)->chunks;
+                view->objectCount = (*previous)->objectCount;
+                std::sort(changes.begin(), changes.end());
+                changes.erase(std::unique(changes.begin(), changes.end()), changes.end());
+                for(auto id : changes) file(*view, copied, id, module.findInMemory(id));
+            } else {
+                for(auto& [id, obj] : module.getGameObjects()) {
+                    if(obj->isResident()) file(*view, copied, id, obj.get());
+                }
+            }
+            return view;
+        }
+    }
+
+    const ObjectView* ModuleView::find(int64_t id) const {
+        if(id < 0) return nullptr;
+        auto index = static_cast<size_t>(id) >> chunkBits;
+        if(index >= chunks.size() || !chunks[index]) return nullptr;
+        return chunks[index]->objects[id & ((1 << chunkBits) - 1)].get();
+    }
+
+    const ModuleView* WorldView::module(std::string_view name) const {
+        auto m = findModule(this, name);
+        return m ? m->get() : nullptr;
+    }
+
+    const ObjectView* WorldView::find(std::string_view module, int64_t id) const {
+        auto m = this->module(module);
+        return m ? m->find(id) : nullptr;
+    }
+
+    void enable() {
+        publishing.store(true);
+    }
+
+    bool enabled() {
+        return publishing.load(std::memory_order_relaxed);
+    }
+
+    void publish() {
+        if(!enabled()) return;
+        auto previous = latest.load(std::memory_order_relaxed);
+        auto next = new WorldView;
+        next->tick = ++lastTick;
+        // gameModules is a sorted map, so the modules come out sorted too.
+        for(auto& [name, module] : gameModules) {
+            next->modules.push_back(buildModule(*module, findModule(previous, name)));
+        }
+
+        // A reader that announced an epoch after the increment below is guaranteed to see next;
+        // one that announced it before may still hold previous.
+        latest.store(next, std::memory_order_seq_cst);
+        if(previous) retired.emplace_back(globalEpoch.load(std::memory_order_relaxed), previous);
+        globalEpoch.fetch_add(1, std::memory_order_seq_cst);
+        reclaim();
+    }
+
+    Reader::Reader() {
+        auto& slot = claimSlot();
+        if(threadSlot.depth++ == 0) slot.epoch.store(globalEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        current = latest.load(std::memory_order_seq_cst);
+    }
+
+    Reader::~Reader() {
+        if(--threadSlot.depth == 0) threadSlot.slot->epoch.store(idle, std::memory_order_release);
+    }
+
+    size_t retiredCount() {
+        return retired.size();
+    }
+
+    void shutdown() {
+        publishing.store(false);
+        auto last = latest.exchange(nullptr, std::memory_order_seq_cst);
+        if(last) retired.emplace_back(globalEpoch.fetch_add(1, std::memory_order_seq_cst), last);
+        // New readers see no view now; give the ones still reading a moment to finish.
+        for(int i = 0; i < 100; i++) {
+            reclaim();
+            if(retired.empty()) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        logger->warn("Readview: {} views are still being read at shutdown; they are left allocated.", retired.size());
+        retired.clear();
+    }
+}
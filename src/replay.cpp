@@ -0,0 +1,109 @@
+#include "kai/replay.h"
+#include "kai/comm.h"
+#include "kai/serialization.h"
+
+namespace net {
+    std::unique_ptr<LinkRecorder> recorder;
+
+    namespace {
+        bool readVarint(std::istream& in, uint64_t& value) {
+            value = 0;
+            for(int shift = 0; shift < 64; shift += 7) {
+                auto c = in.get();
+                if(c == EOF) return false;
+                value |= uint64_t(c & 0x7F) << shift;
+                if(!(c & 0x80)) return true;
+            }
+            return false;
+        }
+    }
+
+    LinkRecorder::LinkRecorder(const std::string& path) : out(path, std::ios::binary | std::ios::trunc) {
+        if(!out.is_open()) throw std::runtime_error(fmt::format("Could not open Link recording {}", path));
+        out.write(recordingMagic.data(), recordingMagic.size());
+        last = std::chrono::steady_clock::now();
+    }
+
+    LinkRecorder::~LinkRecorder() {
+        std::lock_guard<std::mutex> lock(mutex);
+        out.flush();
+    }
+
+    void LinkRecorder::record(std::string_view frame) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        buffer.clear();
+        serial::appendVarint(buffer, std::chrono::duration_cast<std::chrono::microseconds>(now - last).count());
+        serial::appendVarint(buffer, frame.size());
+        last = now;
+        out.write(buffer.data(), buffer.size());
+        out.write(frame.data(), frame.size());
+    }
+
+    LinkRecording::LinkRecording(const std::string& path) : in(path, std::ios::binary) {
+        if(!in.is_open()) throw std::runtime_error(fmt::format("Could not open Link recording {}", path));
+        std::string magic(recordingMagic.size(), '\0');
+        in.read(magic.data(), magic.size());
+        if(magic != recordingMagic) throw std::runtime_error(fmt::format("{} is not a Link recording", path));
+    }
+
+    bool LinkRecording::next(std::chrono::microseconds& delay, std::string& frame) {
+        uint64_t micros, length;
+        if(!readVarint(in, micros) || !readVarint(in, length)) return false;
+        frame.resize(length);
+        if(!in.read(frame.data(), length)) return false;
+        delay = std::chrono::microseconds(micros);
+        return true;
+    }
+
+    // Stands in for Link::runWriter(); without it the outbound channel fills up and
+    // Connection::sendMessage() starts dropping frames.
+    static awaitable<void> drainOutput(std::shared_ptr<ReplayStats> stats) {
+        while(true) {
+            auto message = co_await linkChannel->async_receive(boost::asio::use_awaitable);
+            stats->framesOut++;
+            stats->bytesOut += message.dump(-1, ' ', false, nlohmann::json::error_handler_t::ignore).size();
+        }
+    }
+
+    awaitable<ReplayStats> replayLink(std::string path, bool realtime) {
+        auto output = std::make_shared<ReplayStats>();
+        ReplayStats stats;
+        LinkRecording recording(path);
+        boost::asio::co_spawn(boost::asio::make_strand(*io), drainOutput(output), boost::asio::detached);
+
+        boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor);
+        auto start = std::chrono::steady_clock::now();
+        auto due = start;
+        std::chrono::microseconds delay;
+        std::string frame;
+
+        logger->info("Replay: playing {} {}.", path, realtime ? "in real time" : "as fast as possible");
+        while(!circle_shutdown && recording.next(delay, frame)) {
+            if(realtime) {
+                due += delay;
+                if(due > std::chrono::steady_clock::now()) {
+                    timer.expires_at(due);
+                    co_await timer.async_wait(boost::asio::use_awaitable);
+                }
+            } else if(!(stats.framesIn % 64)) {
+                // let the game strand in every now and then on a single-threaded executor.
+                co_await boost::asio::post(co_await boost::asio::this_coro::executor, boost::asio::use_awaitable);
+            }
+            stats.framesIn++;
+            stats.bytesIn += frame.size();
+            try {
+                auto j = nlohmann::json::parse(frame);
+                co_await routeLinkMessage(j);
+            } catch(const std::exception& e) {
+                logger->error("Replay: bad frame {}: {}", stats.framesIn, e.what());
+            }
+        }
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.framesOut = output->framesOut;
+        stats.bytesOut = output->bytesOut;
+        logger->info("Replay: finished {} frames in {:.3f}s.", stats.framesIn, stats.seconds);
+        circle_shutdown = 1;
+        co_return stats;
+    }
+}
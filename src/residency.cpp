@@ -0,0 +1,105 @@
+#include "kai/residency.h"
+#include "kai/config.h"
+#include "kai/persistence.h"
+#include "kai/snapshot.h"
+
+namespace residency {
+    std::atomic<uint64_t> clock{1};
+    std::atomic<int64_t> residentBytes{0};
+
+    namespace {
+        // Loads can come from several input partitions at once; they share one read connection.
+        std::mutex storeMutex;
+        std::unique_ptr<storage::Store> store;
+
+        storage::Store& readStore() {
+            if(!store) {
+                store = std::make_unique<storage::Store>(fmt::format("{}.sqlite3", config::assetDbName));
+                store->createSchema();
+            }
+            return *store;
+        }
+    }
+
+    bool load(GameObject& obj) {
+        if(auto blob = snapshot::find(obj.getModule()->getName(), obj.getID(), obj.getGeneration())) {
+            obj.restore(*blob, {});
+            obj.noteEncodedSize(blob->size());
+            return true;
+        }
+        int64_t generation;
+        std::string data;
+        std::vector<serial::FieldChange> fields;
+        {
+            std::lock_guard<std::mutex> lock(storeMutex);
+            if(!readStore().loadObject(obj.getModule()->getName(), obj.getID(), generation, data, fields)) return false;
+        }
+        if(generation != obj.getGeneration()) {
+            logger->warn("{}: saved generation is {}, not loading it.", obj.renderID(), generation);
+            return false;
+        }
+        obj.restore(data, fields);
+        size_t bytes = data.size();
+        for(auto& f : fields) bytes += f.category.size() + f.name.size() + (f.value ? f.value->size() : 0);
+        obj.noteEncodedSize(bytes);
+        return true;
+    }
+
+    std::optional<int64_t> savedGeneration(const std::string& module, int64_t id) {
+        std::lock_guard<std::mutex> lock(storeMutex);
+        return readStore().objectGeneration(module, id);
+    }
+
+    int64_t savedMaxId(const std::string& module) {
+        std::lock_guard<std::mutex> lock(storeMutex);
+        return readStore().maxObjectId(module);
+    }
+
+    void evict() {
+        auto budget = config::residencyBudget;
+        auto overBudget = budget > 0 && residentBytes.load(std::memory_order_relaxed) > budget;
+        // Paged modules over their own memory limit evict too, whatever the global budget says.
+        std::set<const GameModule*> overLimit;
+        for(auto& [name, module] : gameModules) {
+            if(module->isPaged() && module->getMemory().overLimit()) overLimit.insert(module.get());
+        }
+        if(!overBudget && overLimit.empty()) {
+            clock.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        auto now = clock.fetch_add(1, std::memory_order_relaxed);
+        std::vector<std::pair<uint64_t, GameObject*>> candidates;
+        for(auto& [name, module] : gameModules) {
+            if(!module->isPaged() || (!overBudget && !overLimit.contains(module.get()))) continue;
+            for(auto& [id, obj] : module->getGameObjects()) {
+                auto last = obj->lastTouched();
+                if(obj->isResident() && last < now) candidates.emplace_back(last, obj.get());
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        // Evict down to 90% of the budget (or limit) so that we are not back here next tick.
+        auto target = budget - budget / 10;
+        auto needed = [&](const GameModule* module) {
+            if(overBudget && residentBytes.load(std::memory_order_relaxed) > target) return true;
+            if(!overLimit.contains(module)) return false;
+            auto limit = module->getMemory().limit();
+            return module->getMemory().bytes() > limit - limit / 10;
+        };
+        size_t evicted = 0;
+        for(auto& [last, obj] : candidates) {
+            if(!needed(obj->getModule())) continue;
+            if(!persistence::isSettled(obj->getModule()->getName(), obj->getID())) continue;
+            if(obj->evict()) evicted++;
+        }
+        if(evicted) {
+            logger->info("Residency: evicted {} objects, {} bytes resident.", evicted, residentBytes.load());
+        }
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(storeMutex);
+        store.reset();
+    }
+}
@@ -1,8 +1,21 @@
 #include "kai/scripting.h"
 #include "kai/structs.h"
+#include "kai/query.h"
 
 
 namespace script {
+    std::atomic<std::shared_ptr<const std::string>> runningScript;
+    std::atomic<bool> tracebackRequested{false};
+
+    // Luau calls this at safe points on the thread that is running bytecode, which makes it the
+    // one place where another thread can get a look at a script's stack.
+    static void interrupt(lua_State *L, int gc) {
+        if(gc >= 0) return;
+        if(tracebackRequested.exchange(false)) {
+            logger->warn("Lua stack of running task:\n{}", lua_debugtrace(L));
+        }
+    }
+
     Task::Task(lua_State *thread, const CompiledScript& code) : code(code) {
         L = thread;
         //luaL_sandboxthread(L);
@@ -31,18 +44,35 @@ namespace script {
             default:
                 break;
         }
+        auto& source = code.code;
+        runningScript.store(std::make_shared<const std::string>(source.substr(0, std::min<size_t>(source.find('\n'), 80))));
         auto status = lua_pcall(L, 0, LUA_MULTRET, 0);
+        runningScript.store(nullptr);
         logger->info("Lua Status: {}", status);
     }
 
     ScriptManager::ScriptManager() {
         L = luaL_newstate();
         luaL_openlibs(L);
+        lua_callbacks(L)->interrupt = interrupt;
+        query::registerLua(L);
         //luaL_sandbox(L);
     }
 
     lua_State *ScriptManager::createThread() {
-        return lua_newthread(L);;
+        // Anchor the thread in the registry instead of leaving it on the main stack, which
+        // would overflow after a few dozen threads.
+        auto thread = lua_newthread(L);
+        threads[thread] = lua_ref(L, -1);
+        lua_pop(L, 1);
+        return thread;
+    }
+
+    void ScriptManager::releaseThread(lua_State *thread) {
+        if(auto it = threads.find(thread); it != threads.end()) {
+            lua_unref(L, it->second);
+            threads.erase(it);
+        }
     }
 
     CompiledScript ScriptManager::compile(const std::string& source) {
@@ -55,7 +85,8 @@ namespace script {
             free(bytecode);
             throw std::runtime_error("Failed to compile script");
         }
-        auto bytes = std::make_shared<std::string>(bytecode);
+        // bytecode is binary and holds NULs; take all of it.
+        auto bytes = std::make_shared<std::string>(bytecode, outsize);
         free(bytecode);
         // check if the bytecode is valid... meaning, the first byte is not a 0.
         if((*bytes)[0] == 0) {
@@ -0,0 +1,166 @@
+#include "kai/serialization.h"
+#include <bit>
+#include <cstring>
+
+namespace serial {
+
+    void appendVarint(std::string& out, uint64_t value) {
+        while(value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    namespace {
+        size_t varintSize(uint64_t value) {
+            size_t size = 1;
+            while(value >= 0x80) {
+                value >>= 7;
+                size++;
+            }
+            return size;
+        }
+    }
+
+    void Writer::f64(double value) {
+        // always little-endian on disk.
+        auto bits = std::bit_cast<uint64_t>(value);
+        for(int i = 0; i < 8; i++) body.push_back(static_cast<char>((bits >> (i * 8)) & 0xFF));
+    }
+
+    void Writer::str(std::string_view value) {
+        varint(value.size());
+        body.append(value);
+    }
+
+    void Writer::key(std::string_view name) {
+        auto it = keyIndex.find(name);
+        if(it == keyIndex.end()) {
+            it = keyIndex.emplace(std::string(name), static_cast<uint32_t>(keys.size())).first;
+            keys.emplace_back(name);
+        }
+        varint(it->second);
+    }
+
+    size_t Writer::beginField(uint32_t tag) {
+        varint(tag);
+        fields.push_back(Field{body.size(), 0});
+        return fields.size() - 1;
+    }
+
+    void Writer::endField(size_t mark) {
+        fields[mark].length = body.size() - fields[mark].start;
+    }
+
+    void Writer::writeBody(std::string& out) const {
+        // A field's length also counts the lengths of the fields nested in it, which are the ones
+        // after it that start no later than it ends. Going backwards, those are all known.
+        std::vector<uint64_t> lengths(fields.size());
+        std::vector<size_t> lengthBytes(fields.size() + 1, 0);
+        for(size_t i = fields.size(); i-- > 0;) {
+            auto end = fields[i].start + fields[i].length;
+            auto after = std::upper_bound(fields.begin() + i + 1, fields.end(), end, [](size_t at, const Field& f) { return at < f.start; });
+            lengths[i] = fields[i].length + lengthBytes[i + 1] - lengthBytes[after - fields.begin()];
+            lengthBytes[i] = lengthBytes[i + 1] + varintSize(lengths[i]);
+        }
+
+        size_t at = 0;
+        for(size_t i = 0; i < fields.size(); i++) {
+            out.append(body, at, fields[i].start - at);
+            appendVarint(out, lengths[i]);
+            at = fields[i].start;
+        }
+        out.append(body, at);
+    }
+
+    std::string Writer::finish(Kind kind, uint32_t version) {
+        std::string out;
+        size_t keyBytes = 0;
+        for(auto& k : keys) keyBytes += k.size() + 2;
+        out.reserve(8 + keyBytes + body.size() + fields.size() * 2);
+        out.push_back(static_cast<char>(magic));
+        out.push_back(static_cast<char>(kind));
+        appendVarint(out, version);
+        appendVarint(out, keys.size());
+        for(auto& k : keys) {
+            appendVarint(out, k.size());
+            out.append(k);
+        }
+        writeBody(out);
+
+        body.clear();
+        fields.clear();
+        keys.clear();
+        keyIndex.clear();
+        return out;
+    }
+
+    std::string Writer::finishBare() {
+        if(!keys.empty()) throw Error("a bare body cannot hold interned keys");
+        std::string out;
+        out.reserve(body.size() + fields.size() * 2);
+        writeBody(out);
+        body.clear();
+        fields.clear();
+        return out;
+    }
+
+    Reader::Reader(std::string_view blob, Kind kind) : data(blob), keys(std::make_shared<std::vector<std::string_view>>()) {
+        if(u8() != magic) throw Error("not a binary blob");
+        auto k = u8();
+        if(k != static_cast<uint8_t>(kind)) {
+            throw Error(fmt::format("expected a blob of kind {}, got {}", static_cast<int>(kind), k));
+        }
+        formatVersion = static_cast<uint32_t>(varint());
+        auto count = varint();
+        if(count > data.size()) throw Error("corrupt key table");
+        keys->reserve(count);
+        for(uint64_t i = 0; i < count; i++) keys->push_back(str());
+    }
+
+    std::string_view Reader::take(size_t count) {
+        if(count > data.size() - pos) throw Error("unexpected end of blob");
+        auto out = data.substr(pos, count);
+        pos += count;
+        return out;
+    }
+
+    uint8_t Reader::u8() {
+        return static_cast<uint8_t>(take(1)[0]);
+    }
+
+    uint64_t Reader::varint() {
+        uint64_t value = 0;
+        for(int shift = 0; shift < 64; shift += 7) {
+            auto c = u8();
+            value |= uint64_t(c & 0x7F) << shift;
+            if(!(c & 0x80)) return value;
+        }
+        throw Error("varint too long");
+    }
+
+    double Reader::f64() {
+        auto bytes = take(8);
+        uint64_t bits = 0;
+        for(int i = 0; i < 8; i++) bits |= uint64_t(static_cast<uint8_t>(bytes[i])) << (i * 8);
+        return std::bit_cast<double>(bits);
+    }
+
+    std::string_view Reader::str() {
+        return take(varint());
+    }
+
+    std::string_view Reader::key() {
+        auto index = varint();
+        if(!keys || index >= keys->size()) throw Error(fmt::format("key index {} out of range", index));
+        return (*keys)[index];
+    }
+
+    bool Reader::nextField(uint32_t& tag, Reader& field) {
+        if(atEnd()) return false;
+        tag = static_cast<uint32_t>(varint());
+        field = Reader(take(varint()), keys, formatVersion);
+        return true;
+    }
+}
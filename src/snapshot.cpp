@@ -0,0 +1,336 @@
+#include "kai/snapshot.h"
+#include "kai/config.h"
+#include "kai/storage.h"
+#include <bit>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace snapshot {
+    static_assert(std::endian::native == std::endian::little, "snapshots are written in host byte order");
+
+    namespace {
+        constexpr std::string_view magic = "KAISNAP1";
+        constexpr uint32_t formatVersion = 1;
+        const std::string metaKey = "snapshot_token";
+
+        // Everything in the file is addressed by offsets from its start, so it can be mapped
+        // anywhere.
+        struct FileHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t moduleCount;
+            uint64_t fileSize;
+            uint64_t modulesOffset;
+            char token[32];
+        };
+
+        struct ModuleRecord {
+            uint64_t nameOffset;
+            uint32_t nameLength;
+            uint32_t paged;
+            uint64_t indexOffset;
+            uint64_t count;
+        };
+
+        // Sorted by id within a module.
+        struct IndexEntry {
+            int64_t id;
+            int64_t generation;
+            uint64_t offset;
+            uint64_t length;
+        };
+
+        struct ModuleView {
+            const IndexEntry* entries{nullptr};
+            size_t count{0};
+            bool paged{false};
+        };
+
+        const char* mapping{nullptr};
+        size_t mappingSize{0};
+        std::unordered_map<std::string, ModuleView> modules;
+
+        // Objects saved since boot; their entries are stale.
+        std::mutex invalidMutex;
+        std::set<std::pair<std::string, int64_t>> invalidated;
+
+        // materialize() walks the non-paged modules in order.
+        std::vector<std::pair<GameModule*, const ModuleView*>> pendingModules;
+        size_t moduleCursor{0}, entryCursor{0};
+
+        std::string newToken() {
+            std::random_device rd;
+            return fmt::format("{:08x}{:08x}{:08x}{:08x}", rd(), rd(), rd(), rd());
+        }
+
+        std::string dbPath() {
+            return fmt::format("{}.sqlite3", config::assetDbName);
+        }
+
+        void pad(std::ofstream& out, uint64_t& pos) {
+            static const char zeros[8]{};
+            auto n = (8 - pos % 8) % 8;
+            out.write(zeros, n);
+            pos += n;
+        }
+    }
+
+    void write(const std::string& path) {
+        if(path.empty()) return;
+        auto start = std::chrono::steady_clock::now();
+        auto token = newToken();
+        auto temp = path + ".tmp";
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if(!out) {
+            logger->error("Snapshot: could not create {}", temp);
+            return;
+        }
+
+        FileHeader header{};
+        std::memcpy(header.magic, magic.data(), magic.size());
+        header.version = formatVersion;
+        std::memcpy(header.token, token.data(), std::min(token.size(), sizeof(header.token)));
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        uint64_t pos = sizeof(header);
+
+        std::vector<ModuleRecord> records;
+        std::vector<std::vector<IndexEntry>> indexes;
+        size_t objects = 0;
+        for(auto& [name, module] : gameModules) {
+            auto& record = records.emplace_back();
+            auto& index = indexes.emplace_back();
+            record.paged = module->isPaged();
+            record.nameOffset = pos;
+            record.nameLength = static_cast<uint32_t>(name.size());
+            out.write(name.data(), name.size());
+            pos += name.size();
+
+            // Loading an object below can add shells, which moves the module's objects; walk a copy.
+            std::vector<std::shared_ptr<GameObject>> copy;
+            copy.reserve(module->getGameObjects().size());
+            for(auto& [id, obj] : module->getGameObjects()) copy.push_back(obj);
+            for(auto& obj : copy) {
+                auto id = obj->getID();
+                std::string owned;
+                std::string_view blob;
+                if(obj->isResident()) {
+                    owned = obj->serializeBinary();
+                    blob = owned;
+                } else if(auto old = find(name, id, obj->getGeneration())) {
+                    blob = *old;
+                } else if(!module->isPaged()) {
+                    // loads it; a non-paged module must be complete in the snapshot.
+                    owned = obj->serializeBinary();
+                    blob = owned;
+                } else {
+                    // stays in the database, where a paged module looks for what it misses.
+                    continue;
+                }
+                index.push_back(IndexEntry{id, obj->getGeneration(), pos, blob.size()});
+                out.write(blob.data(), blob.size());
+                pos += blob.size();
+            }
+            // find() binary-searches by id; the module's own order is arbitrary.
+            std::sort(index.begin(), index.end(), [](auto& a, auto& b) { return a.id < b.id; });
+            objects += index.size();
+        }
+
+        for(size_t i = 0; i < records.size(); i++) {
+            pad(out, pos);
+            records[i].indexOffset = pos;
+            records[i].count = indexes[i].size();
+            auto bytes = indexes[i].size() * sizeof(IndexEntry);
+            out.write(reinterpret_cast<const char*>(indexes[i].data()), bytes);
+            pos += bytes;
+        }
+        pad(out, pos);
+        header.modulesOffset = pos;
+        header.moduleCount = static_cast<uint32_t>(records.size());
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(ModuleRecord));
+        pos += records.size() * sizeof(ModuleRecord);
+        header.fileSize = pos;
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if(!out) {
+            logger->error("Snapshot: failed writing {}", temp);
+            std::filesystem::remove(temp);
+            return;
+        }
+
+        // Durable before the database vouches for it.
+        if(auto fd = ::open(temp.c_str(), O_RDONLY); fd >= 0) {
+            ::fsync(fd);
+            ::close(fd);
+        }
+        std::filesystem::rename(temp, path);
+        try {
+            storage::Store store(dbPath());
+            store.createSchema();
+            store.setMeta(metaKey, token);
+        } catch(const std::exception& e) {
+            logger->error("Snapshot: could not record the token: {}", e.what());
+            return;
+        }
+        logger->info("Snapshot: wrote {} objects of {} modules to {} ({} bytes) in {:.1f}ms.", objects, records.size(), path, pos,
+                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    bool open(const std::string& path) {
+        if(path.empty() || mapping || !std::filesystem::exists(path)) return false;
+
+        std::optional<std::string> token;
+        try {
+            storage::Store store(dbPath());
+            store.createSchema();
+            token = store.getMeta(metaKey);
+        } catch(const std::exception& e) {
+            logger->error("Snapshot: could not read the token: {}", e.what());
+            return false;
+        }
+        if(!token) {
+            logger->info("Snapshot: {} is stale, booting from the database.", path);
+            return false;
+        }
+
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        struct stat st{};
+        if(::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader)) {
+            ::close(fd);
+            return false;
+        }
+        auto size = static_cast<size_t>(st.st_size);
+        auto addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(addr == MAP_FAILED) {
+            logger->error("Snapshot: could not map {}", path);
+            return false;
+        }
+        auto base = static_cast<const char*>(addr);
+
+        auto fail = [&](const char* why) {
+            logger->warn("Snapshot: ignoring {}: {}", path, why);
+            ::munmap(addr, size);
+            return false;
+        };
+        FileHeader header;
+        std::memcpy(&header, base, sizeof(header));
+        if(std::string_view(header.magic, sizeof(header.magic)) != magic) return fail("not a snapshot");
+        if(header.version != formatVersion) return fail("unsupported version");
+        if(header.fileSize != size) return fail("truncated");
+        if(std::string_view(header.token, strnlen(header.token, sizeof(header.token))) != *token) return fail("stale");
+        if(header.modulesOffset + uint64_t(header.moduleCount) * sizeof(ModuleRecord) > size) return fail("corrupt module table");
+
+        auto records = reinterpret_cast<const ModuleRecord*>(base + header.modulesOffset);
+        for(uint32_t i = 0; i < header.moduleCount; i++) {
+            auto& r = records[i];
+            if(r.nameOffset + r.nameLength > size || r.indexOffset + r.count * sizeof(IndexEntry) > size) {
+                modules.clear();
+                return fail("corrupt module record");
+            }
+            // A paged module's snapshot may leave objects in the database, which only paging finds.
+            if(bool(r.paged) != (config::residencyBudget > 0)) {
+                modules.clear();
+                return fail("paging was switched on or off since it was written");
+            }
+            ModuleView view;
+            view.entries = reinterpret_cast<const IndexEntry*>(base + r.indexOffset);
+            view.count = r.count;
+            view.paged = r.paged;
+            modules.emplace(std::string(base + r.nameOffset, r.nameLength), view);
+        }
+
+        ::madvise(addr, size, MADV_RANDOM);
+        mapping = base;
+        mappingSize = size;
+        logger->info("Snapshot: mapped {} ({} modules, {} bytes).", path, modules.size(), size);
+        return true;
+    }
+
+    bool isOpen() {
+        return mapping != nullptr;
+    }
+
+    void close() {
+        if(!mapping) return;
+        ::munmap(const_cast<char*>(mapping), mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+        modules.clear();
+        pendingModules.clear();
+        std::lock_guard<std::mutex> lock(invalidMutex);
+        invalidated.clear();
+    }
+
+    void markStale(storage::Store& store) {
+        store.clearMeta(metaKey);
+    }
+
+    std::set<std::string> createModules() {
+        std::set<std::string> names;
+        for(auto& [name, view] : modules) {
+            auto module = std::make_shared<GameModule>(std::filesystem::path(config::modulesDirectory) / name);
+            module->setPaged(view.paged);
+            for(size_t i = 0; i < view.count; i++) {
+                module->createShell(view.entries[i].id, view.entries[i].generation);
+            }
+            if(!view.paged) pendingModules.emplace_back(module.get(), &view);
+            gameModules[name] = module;
+            names.insert(name);
+        }
+        moduleCursor = entryCursor = 0;
+        return names;
+    }
+
+    std::optional<std::string_view> find(const std::string& module, int64_t id, int64_t generation) {
+        if(!mapping) return std::nullopt;
+        auto it = modules.find(module);
+        if(it == modules.end()) return std::nullopt;
+        auto& view = it->second;
+        auto entry = std::lower_bound(view.entries, view.entries + view.count, id,
+                                      [](const IndexEntry& e, int64_t id) { return e.id < id; });
+        if(entry == view.entries + view.count || entry->id != id || entry->generation != generation) return std::nullopt;
+        {
+            std::lock_guard<std::mutex> lock(invalidMutex);
+            if(invalidated.contains({module, id})) return std::nullopt;
+        }
+        if(entry->offset + entry->length > mappingSize) return std::nullopt;
+        return std::string_view(mapping + entry->offset, entry->length);
+    }
+
+    void invalidate(const std::string& module, int64_t id) {
+        if(!mapping) return;
+        std::lock_guard<std::mutex> lock(invalidMutex);
+        invalidated.emplace(module, id);
+    }
+
+    void materialize(size_t budget) {
+        if(!mapping) return;
+        while(budget && moduleCursor < pendingModules.size()) {
+            auto [module, view] = pendingModules[moduleCursor];
+            if(entryCursor >= view->count) {
+                moduleCursor++;
+                entryCursor = 0;
+                continue;
+            }
+            if(auto obj = module->getGameObject(view->entries[entryCursor].id).lock()) {
+                if(!obj->isResident()) {
+                    obj->ensureResident();
+                    budget--;
+                }
+            }
+            entryCursor++;
+        }
+        if(moduleCursor < pendingModules.size()) return;
+        // Paged modules keep reading from the mapping as their objects come and go.
+        bool needed = std::any_of(modules.begin(), modules.end(), [](auto& m) { return m.second.paged; });
+        if(!needed) {
+            logger->info("Snapshot: every object is resident, releasing the mapping.");
+            close();
+        }
+    }
+}
@@ -0,0 +1,364 @@
+#include "kai/storage.h"
+#include "kai/config.h"
+#include <deque>
+
+namespace storage {
+
+    namespace {
+        struct QueryRegistry {
+            std::mutex mutex;
+            // a deque, so querySql() references stay valid as queries are added.
+            std::deque<std::string> sql;
+        };
+
+        QueryRegistry& registry() {
+            static QueryRegistry r;
+            return r;
+        }
+
+        // 4 parameters per row keeps a full batch under SQLite's historic 999 parameter limit.
+        constexpr int bulkRows = 128;
+
+        std::string upsertSql(int rows) {
+            std::string sql = "INSERT INTO objects (module, id, generation, data) VALUES ";
+            for(int i = 0; i < rows; i++) {
+                if(i) sql += ", ";
+                sql += "(?, ?, ?, ?)";
+            }
+            sql += " ON CONFLICT(module, id) DO UPDATE SET generation=excluded.generation, data=excluded.data";
+            return sql;
+        }
+
+        const QueryId upsertObject = registerQuery(upsertSql(1));
+        const QueryId upsertObjects = registerQuery(upsertSql(bulkRows));
+        const QueryId deleteObject = registerQuery("DELETE FROM objects WHERE module=? AND id=?");
+        const QueryId deleteFields = registerQuery("DELETE FROM object_fields WHERE module=? AND id=?");
+        const QueryId upsertField = registerQuery(
+                "INSERT INTO object_fields (module, id, field, category, name, value) VALUES (?, ?, ?, ?, ?, ?) "
+                "ON CONFLICT(module, id, field, category, name) DO UPDATE SET value=excluded.value");
+        const QueryId selectObject = registerQuery("SELECT generation, data FROM objects WHERE module=? AND id=?");
+        const QueryId selectGeneration = registerQuery("SELECT generation FROM objects WHERE module=? AND id=?");
+        const QueryId selectMaxId = registerQuery("SELECT COALESCE(MAX(id), 0) FROM objects WHERE module=?");
+        const QueryId selectModuleObjects = registerQuery("SELECT id, generation, data FROM objects WHERE module=?");
+        const QueryId selectModuleFields = registerQuery("SELECT id, field, category, name, value FROM object_fields WHERE module=? ORDER BY id");
+        const QueryId selectModuleIds = registerQuery("SELECT id FROM objects WHERE module=?");
+        const QueryId selectFields = registerQuery("SELECT field, category, name, value FROM object_fields WHERE module=? AND id=?");
+        const QueryId selectMeta = registerQuery("SELECT value FROM meta WHERE key=?");
+        const QueryId upsertMeta = registerQuery("INSERT INTO meta(key, value) VALUES(?, ?) ON CONFLICT(key) DO UPDATE SET value=excluded.value");
+        const QueryId deleteMeta = registerQuery("DELETE FROM meta WHERE key=?");
+
+        void bindObject(SQLite::Statement& st, int first, const ObjectRecord& r) {
+            st.bindNoCopy(first, r.module);
+            st.bind(first + 1, r.id);
+            st.bind(first + 2, r.generation);
+            // a blob, not text: the data is the binary GameObject encoding.
+            st.bindNoCopy(first + 3, r.data.data(), static_cast<int>(r.data.size()));
+        }
+    }
+
+    PragmaProfile defaultProfile() {
+        PragmaProfile p;
+        p.synchronous = config::sqliteSynchronous;
+        p.mmapSize = config::sqliteMmapSize;
+        p.cacheSize = config::sqliteCacheSize;
+        // Without the Checkpointer, let SQLite checkpoint on commit as usual.
+        if(config::walCheckpointInterval <= std::chrono::milliseconds::zero()) p.walAutoCheckpoint = 1000;
+        return p;
+    }
+
+    void applyProfile(SQLite::Database& db, const PragmaProfile& profile) {
+        db.setBusyTimeout(profile.busyTimeoutMs);
+        db.exec(fmt::format("PRAGMA journal_mode={}", profile.journalMode));
+        db.exec(fmt::format("PRAGMA synchronous={}", profile.synchronous));
+        db.exec(fmt::format("PRAGMA mmap_size={}", profile.mmapSize));
+        db.exec(fmt::format("PRAGMA cache_size={}", profile.cacheSize));
+        db.exec(fmt::format("PRAGMA wal_autocheckpoint={}", profile.walAutoCheckpoint));
+        db.exec("PRAGMA temp_store=MEMORY");
+    }
+
+    void merge(ObjectRecord& older, ObjectRecord&& newer) {
+        if(newer.full || newer.deleted || older.deleted) {
+            older = std::move(newer);
+            return;
+        }
+        older.generation = newer.generation;
+        older.fields.insert(older.fields.end(), std::make_move_iterator(newer.fields.begin()),
+                            std::make_move_iterator(newer.fields.end()));
+    }
+
+    QueryId registerQuery(std::string sql) {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for(size_t i = 0; i < r.sql.size(); i++) {
+            if(r.sql[i] == sql) return static_cast<QueryId>(i);
+        }
+        r.sql.push_back(std::move(sql));
+        return static_cast<QueryId>(r.sql.size() - 1);
+    }
+
+    const std::string& querySql(QueryId id) {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        return r.sql.at(id);
+    }
+
+    Store::Store(const std::string& path, const PragmaProfile& profile)
+        : database(path, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE) {
+        applyProfile(database, profile);
+    }
+
+    SQLite::Statement& Store::statement(QueryId id) {
+        if(id >= statements.size()) statements.resize(id + 1);
+        auto& st = statements[id];
+        if(!st) {
+            st = std::make_unique<SQLite::Statement>(database, querySql(id));
+        } else {
+            st->reset();
+            st->clearBindings();
+        }
+        return *st;
+    }
+
+    size_t Store::cachedStatements() const {
+        return std::count_if(statements.begin(), statements.end(), [](auto& st) { return st != nullptr; });
+    }
+
+    void Store::createSchema() {
+        database.exec("CREATE TABLE IF NOT EXISTS objects ("
+                      "module TEXT NOT NULL, "
+                      "id INTEGER NOT NULL, "
+                      "generation INTEGER NOT NULL, "
+                      "data BLOB NOT NULL, "
+                      "PRIMARY KEY(module, id))");
+        // value is NULL for an entry removed since the blob was written.
+        database.exec("CREATE TABLE IF NOT EXISTS object_fields ("
+                      "module TEXT NOT NULL, "
+                      "id INTEGER NOT NULL, "
+                      "field INTEGER NOT NULL, "
+                      "category TEXT NOT NULL, "
+                      "name TEXT NOT NULL, "
+                      "value BLOB, "
+                      "PRIMARY KEY(module, id, field, category, name)) WITHOUT ROWID");
+        database.exec("CREATE TABLE IF NOT EXISTS meta (key TEXT PRIMARY KEY, value TEXT NOT NULL)");
+    }
+
+    void Store::saveObjects(std::vector<ObjectRecord>& records) {
+        // Deletions first, then full saves, then delta-only records.
+        auto deletedEnd = std::stable_partition(records.begin(), records.end(), [](auto& r) { return r.deleted; });
+        auto fullEnd = std::stable_partition(deletedEnd, records.end(), [](auto& r) { return r.full; });
+
+        auto dropFields = [&](const ObjectRecord& r) {
+            auto& st = statement(deleteFields);
+            st.bindNoCopy(1, r.module);
+            st.bind(2, r.id);
+            st.exec();
+        };
+
+        SQLite::Transaction transaction(database);
+        for(auto it = records.begin(); it != deletedEnd; ++it) {
+            auto& st = statement(deleteObject);
+            st.bindNoCopy(1, it->module);
+            st.bind(2, it->id);
+            st.exec();
+            dropFields(*it);
+        }
+
+        auto it = deletedEnd;
+        while(fullEnd - it >= bulkRows) {
+            auto& st = statement(upsertObjects);
+            for(int i = 0; i < bulkRows; i++, ++it) bindObject(st, i * 4 + 1, *it);
+            st.exec();
+        }
+        for(; it != fullEnd; ++it) {
+            auto& st = statement(upsertObject);
+            bindObject(st, 1, *it);
+            st.exec();
+        }
+        for(it = deletedEnd; it != fullEnd; ++it) dropFields(*it);
+
+        // A full record may still carry fields that changed after its blob was taken; they are
+        // applied on top in order, so the latest change of an entry wins.
+        for(it = deletedEnd; it != records.end(); ++it) {
+            for(auto& f : it->fields) {
+                auto& st = statement(upsertField);
+                st.bindNoCopy(1, it->module);
+                st.bind(2, it->id);
+                st.bind(3, static_cast<int64_t>(f.field));
+                st.bindNoCopy(4, f.category);
+                st.bindNoCopy(5, f.name);
+                if(f.value) st.bindNoCopy(6, f.value->data(), static_cast<int>(f.value->size()));
+                else st.bind(6);
+                st.exec();
+            }
+        }
+        transaction.commit();
+    }
+
+    bool Store::loadObject(const std::string& module, int64_t id, int64_t& generation, std::string& data,
+                           std::vector<serial::FieldChange>& fields) {
+        auto& object = statement(selectObject);
+        object.bindNoCopy(1, module);
+        object.bind(2, id);
+        if(!object.executeStep()) {
+            object.reset();
+            return false;
+        }
+        generation = object.getColumn(0).getInt64();
+        auto blob = object.getColumn(1);
+        data.assign(static_cast<const char*>(blob.getBlob()), blob.getBytes());
+        // A statement left on a row keeps its read transaction open, and this connection would
+        // stop seeing what the writer commits.
+        object.reset();
+
+        fields.clear();
+        auto& rows = statement(selectFields);
+        rows.bindNoCopy(1, module);
+        rows.bind(2, id);
+        while(rows.executeStep()) {
+            serial::FieldChange f;
+            f.field = static_cast<uint32_t>(rows.getColumn(0).getInt64());
+            f.category = rows.getColumn(1).getString();
+            f.name = rows.getColumn(2).getString();
+            auto value = rows.getColumn(3);
+            if(!value.isNull()) f.value.emplace(static_cast<const char*>(value.getBlob()), value.getBytes());
+            fields.push_back(std::move(f));
+        }
+        return true;
+    }
+
+    void Store::forEachObject(const std::string& module, const std::function<void(int64_t, int64_t, std::string_view)>& fn) {
+        auto& st = statement(selectModuleObjects);
+        st.bindNoCopy(1, module);
+        while(st.executeStep()) {
+            auto blob = st.getColumn(2);
+            fn(st.getColumn(0).getInt64(), st.getColumn(1).getInt64(),
+               std::string_view(static_cast<const char*>(blob.getBlob()), blob.getBytes()));
+        }
+    }
+
+    void Store::forEachField(const std::string& module, const std::function<void(int64_t, serial::FieldChange&&)>& fn) {
+        auto& st = statement(selectModuleFields);
+        st.bindNoCopy(1, module);
+        while(st.executeStep()) {
+            serial::FieldChange f;
+            f.field = static_cast<uint32_t>(st.getColumn(1).getInt64());
+            f.category = st.getColumn(2).getString();
+            f.name = st.getColumn(3).getString();
+            auto value = st.getColumn(4);
+            if(!value.isNull()) f.value.emplace(static_cast<const char*>(value.getBlob()), value.getBytes());
+            fn(st.getColumn(0).getInt64(), std::move(f));
+        }
+    }
+
+    std::vector<int64_t> Store::objectIds(const std::string& module) {
+        std::vector<int64_t> ids;
+        auto& st = statement(selectModuleIds);
+        st.bindNoCopy(1, module);
+        while(st.executeStep()) ids.push_back(st.getColumn(0).getInt64());
+        return ids;
+    }
+
+    std::optional<int64_t> Store::objectGeneration(const std::string& module, int64_t id) {
+        auto& st = statement(selectGeneration);
+        st.bindNoCopy(1, module);
+        st.bind(2, id);
+        std::optional<int64_t> generation;
+        if(st.executeStep()) generation = st.getColumn(0).getInt64();
+        st.reset();
+        return generation;
+    }
+
+    int64_t Store::maxObjectId(const std::string& module) {
+        auto& st = statement(selectMaxId);
+        st.bindNoCopy(1, module);
+        int64_t id = st.executeStep() ? st.getColumn(0).getInt64() : 0;
+        st.reset();
+        return id;
+    }
+
+    std::optional<std::string> Store::getMeta(const std::string& key) {
+        auto& st = statement(selectMeta);
+        st.bindNoCopy(1, key);
+        std::optional<std::string> value;
+        if(st.executeStep()) value = st.getColumn(0).getString();
+        st.reset();
+        return value;
+    }
+
+    void Store::setMeta(const std::string& key, const std::string& value) {
+        auto& st = statement(upsertMeta);
+        st.bindNoCopy(1, key);
+        st.bindNoCopy(2, value);
+        st.exec();
+    }
+
+    void Store::clearMeta(const std::string& key) {
+        auto& st = statement(deleteMeta);
+        st.bindNoCopy(1, key);
+        st.exec();
+    }
+
+    Checkpointer::~Checkpointer() {
+        stop();
+    }
+
+    void Checkpointer::start(const std::string& path, std::chrono::milliseconds interval) {
+        if(running || interval <= std::chrono::milliseconds::zero()) return;
+        running = true;
+        thread = std::thread(&Checkpointer::run, this, path, interval);
+    }
+
+    void Checkpointer::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!running) return;
+            running = false;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    void Checkpointer::request() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requested = true;
+        }
+        wake.notify_all();
+    }
+
+    void Checkpointer::run(std::string path, std::chrono::milliseconds interval) {
+        std::unique_ptr<SQLite::Database> db;
+        try {
+            db = std::make_unique<SQLite::Database>(path, SQLite::OPEN_READWRITE);
+            db->setBusyTimeout(defaultProfile().busyTimeoutMs);
+        } catch(const std::exception& e) {
+            logger->error("Checkpointer: could not open {}: {}", path, e.what());
+            return;
+        }
+
+        auto checkpoint = [&](const char* mode) {
+            try {
+                // returns (busy, wal frames, checkpointed frames)
+                SQLite::Statement st(*db, fmt::format("PRAGMA wal_checkpoint({})", mode));
+                if(st.executeStep() && st.getColumn(0).getInt()) {
+                    logger->warn("Checkpointer: {} checkpoint of {} could not complete, {} of {} frames copied.",
+                                 mode, path, st.getColumn(2).getInt(), st.getColumn(1).getInt());
+                }
+            } catch(const std::exception& e) {
+                logger->error("Checkpointer: {} checkpoint of {} failed: {}", mode, path, e.what());
+            }
+        };
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while(running) {
+            wake.wait_for(lock, interval, [&] { return !running || requested; });
+            if(!running) break;
+            requested = false;
+            lock.unlock();
+            checkpoint("PASSIVE");
+            lock.lock();
+        }
+        lock.unlock();
+        checkpoint("TRUNCATE");
+    }
+}
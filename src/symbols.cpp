@@ -0,0 +1,53 @@
+#include "kai/symbols.h"
+#include <deque>
+#include <shared_mutex>
+
+namespace symbols {
+
+    namespace {
+        struct Table {
+            std::shared_mutex mutex;
+            // a deque, so names never move and the views in the index stay valid.
+            std::deque<std::string> names;
+            std::unordered_map<std::string_view, Symbol> index;
+        };
+
+        Table& table() {
+            static Table t;
+            return t;
+        }
+    }
+
+    Symbol intern(std::string_view name) {
+        auto& t = table();
+        {
+            std::shared_lock lock(t.mutex);
+            if(auto it = t.index.find(name); it != t.index.end()) return it->second;
+        }
+        std::unique_lock lock(t.mutex);
+        if(auto it = t.index.find(name); it != t.index.end()) return it->second;
+        auto symbol = static_cast<Symbol>(t.names.size());
+        auto& stored = t.names.emplace_back(name);
+        t.index.emplace(stored, symbol);
+        return symbol;
+    }
+
+    Symbol find(std::string_view name) {
+        auto& t = table();
+        std::shared_lock lock(t.mutex);
+        auto it = t.index.find(name);
+        return it == t.index.end() ? none : it->second;
+    }
+
+    const std::string& name(Symbol symbol) {
+        auto& t = table();
+        std::shared_lock lock(t.mutex);
+        return t.names.at(symbol);
+    }
+
+    size_t count() {
+        auto& t = table();
+        std::shared_lock lock(t.mutex);
+        return t.names.size();
+    }
+}
@@ -0,0 +1,129 @@
+#include "kai/watchdog.h"
+#include "kai/config.h"
+#include "kai/profiler.h"
+#include "kai/scripting.h"
+#include <thread>
+#include <condition_variable>
+#include <csignal>
+#include <execinfo.h>
+
+namespace watchdog {
+
+    namespace {
+        constexpr int maxFrames = 64;
+        void* frames[maxFrames];
+        std::atomic<int> frameCount{-1};
+        int backtraceSignal{0};
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool running{false};
+
+        // Runs on the stalled game thread. backtrace() is pre-warmed in start() so that it does
+        // not have to load libgcc from inside the handler.
+        void onBacktraceSignal(int) {
+            frameCount.store(backtrace(frames, maxFrames), std::memory_order_release);
+        }
+
+        std::string describe(profiler::PhaseId id) {
+            return id == profiler::invalidPhase ? "<none>" : profiler::phaseName(id);
+        }
+
+        void dumpBacktrace(pthread_t target) {
+            frameCount.store(-1, std::memory_order_relaxed);
+            if(pthread_kill(target, backtraceSignal)) {
+                logger->error("Watchdog: could not signal the game thread for a backtrace.");
+                return;
+            }
+            int count = -1;
+            for(int i = 0; i < 50 && count < 0; i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                count = frameCount.load(std::memory_order_acquire);
+            }
+            if(count < 0) {
+                logger->error("Watchdog: game thread did not answer the backtrace request.");
+                return;
+            }
+            auto symbols = backtrace_symbols(frames, count);
+            std::string out;
+            for(int i = 0; i < count; i++) {
+                out += fmt::format("\n  #{} {}", i, symbols ? symbols[i] : "?");
+            }
+            free(symbols);
+            logger->warn("Watchdog: game thread backtrace:{}", out);
+        }
+
+        void report(int64_t elapsed) {
+            auto phase = profiler::marker.phase.load(std::memory_order_relaxed);
+            auto system = profiler::marker.system.load(std::memory_order_relaxed);
+            auto inPhase = profiler::now() - profiler::marker.phaseStart.load(std::memory_order_relaxed);
+            logger->warn("Watchdog: tick {} has been running for {:.3f}s. Phase: {} ({:.3f}s), GameSystem: {}",
+                         profiler::marker.tick.load(std::memory_order_relaxed), elapsed / 1e9,
+                         describe(phase), inPhase / 1e9, describe(system));
+
+            dumpBacktrace(profiler::marker.thread.load(std::memory_order_acquire));
+
+            if(auto line = script::runningScript.load(); line) {
+                // The stack itself is logged by the Luau interrupt on the game thread.
+                logger->warn("Watchdog: a script::Task is running: {}", *line);
+                script::tracebackRequested.store(true);
+            }
+        }
+
+        void run() {
+            auto threshold = std::chrono::duration_cast<std::chrono::nanoseconds>(config::watchdogThreshold).count();
+            auto poll = std::max<std::chrono::milliseconds>(config::watchdogThreshold / 10, std::chrono::milliseconds(50));
+            uint64_t reportedTick = UINT64_MAX;
+            int64_t nextReport = 0;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            while(running) {
+                wake.wait_for(lock, poll);
+                if(!running) break;
+
+                auto tickStart = profiler::marker.tickStart.load(std::memory_order_acquire);
+                if(!tickStart) continue;
+                auto tick = profiler::marker.tick.load(std::memory_order_relaxed);
+                auto elapsed = profiler::now() - tickStart;
+                if(elapsed < threshold) continue;
+
+                // Report once per threshold for as long as the same tick stays stuck.
+                if(tick != reportedTick) {
+                    reportedTick = tick;
+                    nextReport = elapsed;
+                }
+                if(elapsed < nextReport) continue;
+                nextReport = elapsed + threshold;
+                report(elapsed);
+            }
+        }
+    }
+
+    void start() {
+        if(config::watchdogThreshold.count() <= 0 || running) return;
+
+        backtraceSignal = SIGRTMIN + 2;
+        struct sigaction sa{};
+        sa.sa_handler = onBacktraceSignal;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(backtraceSignal, &sa, nullptr);
+        void* warm[1];
+        backtrace(warm, 1);
+
+        running = true;
+        thread = std::thread(run);
+        logger->info("Watchdog started with a threshold of {}ms.", config::watchdogThreshold.count());
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!running) return;
+            running = false;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+}